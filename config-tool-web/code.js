@@ -4,14 +4,20 @@ import examples from './examples.js';
 
 const REPORT_ID_CONFIG = 100;
 const UNMAPPED_PASSTHROUGH_FLAG = 0x01;
+const LATE_MOTION_FLAG = 0x02;
 const STICKY_FLAG = 0x01;
+const HIRES_SCROLL_FLAG = 0x01;
 const CONFIG_SIZE = 32;
-const CONFIG_VERSION = 4;
+const CONFIG_VERSION = 7;
 const VENDOR_ID = 0xCAFE;
 const PRODUCT_ID = 0xBAF3;
 const DEFAULT_PARTIAL_SCROLL_TIMEOUT = 1000000;
 const DEFAULT_SCALING = 1000;
 const DEFAULT_SENSITIVITY = 1000;
+const MAX_SENSITIVITY = 65535;  // * 1000, the firmware clamps anything above it
+const MAX_SCREENS = 8;
+const ROUTE_LOCAL_USB = 0;
+const ROUTE_FORWARDER = 1;
 
 const SET_CONFIG = 2;
 const GET_CONFIG = 3;
@@ -36,24 +42,36 @@ let extra_usages = [];
 let config = {
     'version': CONFIG_VERSION,
     'unmapped_passthrough': true,
+    'late_motion': false,
     'partial_scroll_timeout': DEFAULT_PARTIAL_SCROLL_TIMEOUT,
     'interval_override': 0,
     'constraint_mode': 2,
     'offscreen_sensitivity': 4000,
+    'report_priority': {
+        'mouse': 1,
+        'keyboard': 0,
+        'consumer': 2,
+    },
     'screens': [
         {
             'x': 0,
             'y': 0,
             'w': 16000000,
             'h': 9000000,
-            'sensitivity': 4000
+            'sensitivity': 4000,
+            'route': ROUTE_LOCAL_USB,
+            'forwarder_address': 0,
+            'hires_scroll': false
         },
         {
             'x': 16000000,
             'y': 0,
             'w': 16000000,
             'h': 9000000,
-            'sensitivity': 4000
+            'sensitivity': 4000,
+            'route': ROUTE_FORWARDER,
+            'forwarder_address': 0,
+            'hires_scroll': false
         }
     ],
     'mappings': [{
@@ -72,6 +90,7 @@ document.addEventListener("DOMContentLoaded", function () {
     document.getElementById("load_from_device").addEventListener("click", load_from_device);
     document.getElementById("save_to_device").addEventListener("click", save_to_device);
     document.getElementById("add_mapping").addEventListener("click", add_mapping_onclick);
+    document.getElementById("add_screen").addEventListener("click", add_screen_onclick);
     document.getElementById("download_json").addEventListener("click", download_json);
     document.getElementById("upload_json").addEventListener("click", upload_json);
     document.getElementById("file_input").addEventListener("change", file_uploaded);
@@ -81,14 +100,12 @@ document.addEventListener("DOMContentLoaded", function () {
 
     document.getElementById("partial_scroll_timeout_input").addEventListener("change", partial_scroll_timeout_onchange);
     document.getElementById("unmapped_passthrough_checkbox").addEventListener("change", unmapped_passthrough_onchange);
+    document.getElementById("late_motion_checkbox").addEventListener("change", late_motion_onchange);
     document.getElementById("interval_override_dropdown").addEventListener("change", interval_override_onchange);
     document.getElementById("constraint_mode_dropdown").addEventListener("change", constraint_mode_onchange);
     document.getElementById("offscreen_sensitivity_input").addEventListener("change", offscreen_sensitivity_onchange);
-
-    for (let i = 0; i < 2; i++) {
-        for (const param of ['x', 'y', 'w', 'h', 'sensitivity']) {
-            document.getElementById("screen" + i + "_" + param + "_input").addEventListener("change", screens_onchange);
-        }
+    for (const element of document.getElementsByClassName("report_priority_input")) {
+        element.addEventListener("change", report_priority_onchange);
     }
 
     navigator.hid.addEventListener('disconnect', hid_on_disconnect);
@@ -131,27 +148,39 @@ async function load_from_device() {
 
     try {
         await send_feature_command(GET_CONFIG);
-        const [config_version, flags, partial_scroll_timeout, mapping_count, our_usage_count, their_usage_count, interval_override, constraint_mode, offscreen_sensitivity] =
-            await read_config_feature([UINT8, UINT8, UINT32, UINT32, UINT32, UINT32, UINT8, UINT8, UINT32]);
+        const [config_version, flags, partial_scroll_timeout, mapping_count, our_usage_count, their_usage_count, interval_override, constraint_mode, offscreen_sensitivity, screen_count, mouse_priority, keyboard_priority, consumer_priority] =
+            await read_config_feature([UINT8, UINT8, UINT32, UINT32, UINT32, UINT32, UINT8, UINT8, UINT32, UINT8, UINT8, UINT8, UINT8]);
         check_version(config_version);
 
         config['version'] = config_version;
         config['unmapped_passthrough'] = (flags & UNMAPPED_PASSTHROUGH_FLAG) != 0;
+        config['late_motion'] = (flags & LATE_MOTION_FLAG) != 0;
         config['partial_scroll_timeout'] = partial_scroll_timeout;
         config['interval_override'] = interval_override;
         config['constraint_mode'] = constraint_mode;
         config['offscreen_sensitivity'] = offscreen_sensitivity;
+        config['report_priority'] = {
+            'mouse': mouse_priority,
+            'keyboard': keyboard_priority,
+            'consumer': consumer_priority,
+        };
+        config['screens'] = [];
         config['mappings'] = [];
 
-        for (let i = 0; i < 2; i++) {
+        for (let i = 0; i < screen_count; i++) {
             await send_feature_command(GET_SCREEN, [[UINT32, i]]);
-            const [x, y, w, h, sensitivity] =
-                await read_config_feature([UINT32, UINT32, UINT32, UINT32, UINT32]);
-            config['screens'][i]['x'] = x;
-            config['screens'][i]['y'] = y;
-            config['screens'][i]['w'] = w;
-            config['screens'][i]['h'] = h;
-            config['screens'][i]['sensitivity'] = sensitivity;
+            const [x, y, w, h, sensitivity, route, forwarder_address, screen_flags] =
+                await read_config_feature([UINT32, UINT32, UINT32, UINT32, UINT32, UINT8, UINT8, UINT8]);
+            config['screens'].push({
+                'x': x,
+                'y': y,
+                'w': w,
+                'h': h,
+                'sensitivity': sensitivity,
+                'route': route,
+                'forwarder_address': forwarder_address,
+                'hires_scroll': (screen_flags & HIRES_SCROLL_FLAG) != 0,
+            });
         }
 
         for (let i = 0; i < mapping_count; i++) {
@@ -180,16 +209,24 @@ async function save_to_device() {
     clear_error();
 
     try {
+        check_sensitivity(config['offscreen_sensitivity']);
+        for (const screen of config['screens']) {
+            check_sensitivity(screen['sensitivity']);
+        }
         await send_feature_command(SUSPEND);
         await send_feature_command(SET_CONFIG, [
-            [UINT8, config['unmapped_passthrough'] ? UNMAPPED_PASSTHROUGH_FLAG : 0],
+            [UINT8, (config['unmapped_passthrough'] ? UNMAPPED_PASSTHROUGH_FLAG : 0) | (config['late_motion'] ? LATE_MOTION_FLAG : 0)],
             [UINT32, config['partial_scroll_timeout']],
             [UINT8, config['interval_override']],
             [UINT8, config['constraint_mode']],
             [UINT32, config['offscreen_sensitivity']],
+            [UINT8, config['screens'].length],
+            [UINT8, config['report_priority']['mouse']],
+            [UINT8, config['report_priority']['keyboard']],
+            [UINT8, config['report_priority']['consumer']],
         ]);
 
-        for (let i = 0; i < 2; i++) {
+        for (let i = 0; i < config['screens'].length; i++) {
             await send_feature_command(SET_SCREEN, [
                 [UINT8, i],
                 [UINT32, config['screens'][i]['x']],
@@ -197,6 +234,9 @@ async function save_to_device() {
                 [UINT32, config['screens'][i]['w']],
                 [UINT32, config['screens'][i]['h']],
                 [UINT32, config['screens'][i]['sensitivity']],
+                [UINT8, config['screens'][i]['route']],
+                [UINT8, config['screens'][i]['forwarder_address']],
+                [UINT8, config['screens'][i]['hires_scroll'] ? HIRES_SCROLL_FLAG : 0],
             ]);
         }
 
@@ -264,16 +304,21 @@ async function get_usages_from_device() {
 function set_config_ui_state() {
     document.getElementById('partial_scroll_timeout_input').value = Math.round(config['partial_scroll_timeout'] / 1000);
     document.getElementById('unmapped_passthrough_checkbox').checked = config['unmapped_passthrough'];
+    document.getElementById('late_motion_checkbox').checked = config['late_motion'];
     document.getElementById('interval_override_dropdown').value = config['interval_override'];
     document.getElementById('constraint_mode_dropdown').value = config['constraint_mode'];
     document.getElementById('offscreen_sensitivity_input').value = config['offscreen_sensitivity'] / 1000;
+    for (const element of document.getElementsByClassName('report_priority_input')) {
+        element.value = config['report_priority'][element.dataset.report];
+    }
+}
 
-    for (let i = 0; i < 2; i++) {
-        for (const param of ['x', 'y', 'w', 'h']) {
-            document.getElementById('screen' + i + '_' + param + '_input').value = config['screens'][i][param];
-        }
-        document.getElementById('screen' + i + '_sensitivity_input').value = config['screens'][i]['sensitivity'] / 1000;
+function set_screens_ui_state() {
+    clear_children(document.getElementById('screens'));
+    for (const screen of config['screens']) {
+        add_screen(screen);
     }
+    document.getElementById('add_screen').disabled = config['screens'].length >= MAX_SCREENS;
 }
 
 function set_mappings_ui_state() {
@@ -285,9 +330,38 @@ function set_mappings_ui_state() {
 
 function set_ui_state() {
     set_config_ui_state();
+    set_screens_ui_state();
     set_mappings_ui_state();
 }
 
+function add_screen(screen) {
+    const template = document.getElementById("screen_template");
+    const container = document.getElementById("screens");
+    const clone = template.content.cloneNode(true).firstElementChild;
+    const delete_button = clone.querySelector(".delete_button");
+    delete_button.disabled = config['screens'].length <= 1;
+    delete_button.addEventListener("click", delete_screen(screen));
+    clone.querySelector(".screen_number").innerText = config['screens'].indexOf(screen);
+    for (const param of ['x', 'y', 'w', 'h']) {
+        const input = clone.querySelector("." + param + "_input");
+        input.value = screen[param];
+        input.addEventListener("change", screen_param_onchange(screen, param, input));
+    }
+    const sensitivity_input = clone.querySelector(".sensitivity_input");
+    sensitivity_input.value = screen['sensitivity'] / 1000;
+    sensitivity_input.addEventListener("change", screen_sensitivity_onchange(screen, sensitivity_input));
+    const route_dropdown = clone.querySelector(".route_dropdown");
+    route_dropdown.value = screen['route'];
+    route_dropdown.addEventListener("change", screen_param_onchange(screen, 'route', route_dropdown));
+    const forwarder_address_input = clone.querySelector(".forwarder_address_input");
+    forwarder_address_input.value = screen['forwarder_address'];
+    forwarder_address_input.addEventListener("change", screen_param_onchange(screen, 'forwarder_address', forwarder_address_input));
+    const hires_scroll_checkbox = clone.querySelector(".hires_scroll_checkbox");
+    hires_scroll_checkbox.checked = screen['hires_scroll'];
+    hires_scroll_checkbox.addEventListener("change", hires_scroll_onclick(screen, hires_scroll_checkbox));
+    container.appendChild(clone);
+}
+
 function add_mapping(mapping) {
     const template = document.getElementById("mapping_template");
     const container = document.getElementById("mappings");
@@ -430,6 +504,29 @@ function check_version(config_version) {
     }
 }
 
+function check_sensitivity(sensitivity) {
+    if (!(sensitivity >= 0 && sensitivity <= MAX_SENSITIVITY)) {
+        throw new Error("Sensitivity has to be between 0 and " + MAX_SENSITIVITY / 1000 + ".");
+    }
+}
+
+// Out of range values are brought into range, with an error saying so.
+function sensitivity_input_value(element) {
+    if (element.value === '') {
+        return DEFAULT_SENSITIVITY;
+    }
+    const value = Math.round(element.value * 1000);
+    try {
+        check_sensitivity(value);
+        return value;
+    } catch (e) {
+        display_error(e);
+        const clamped = Math.min(MAX_SENSITIVITY, Math.max(0, isNaN(value) ? DEFAULT_SENSITIVITY : value));
+        element.value = clamped / 1000;
+        return clamped;
+    }
+}
+
 function clear_children(element) {
     while (element.firstChild) {
         element.removeChild(element.firstChild);
@@ -449,6 +546,12 @@ function sticky_onclick(mapping, element) {
     };
 }
 
+function hires_scroll_onclick(screen, element) {
+    return function () {
+        screen['hires_scroll'] = element.checked;
+    };
+}
+
 function scaling_onchange(mapping, element) {
     return function () {
         mapping['scaling'] = element.value === '' ? DEFAULT_SCALING : Math.round(parseFloat(element.value) * 1000);
@@ -531,6 +634,10 @@ function unmapped_passthrough_onchange() {
     config['unmapped_passthrough'] = document.getElementById("unmapped_passthrough_checkbox").checked;
 }
 
+function late_motion_onchange() {
+    config['late_motion'] = document.getElementById("late_motion_checkbox").checked;
+}
+
 function interval_override_onchange() {
     config['interval_override'] = parseInt(document.getElementById("interval_override_dropdown").value, 10);
 }
@@ -540,29 +647,51 @@ function constraint_mode_onchange() {
 }
 
 function offscreen_sensitivity_onchange() {
-    let value = document.getElementById('offscreen_sensitivity_input').value;
-    if (value === '') {
-        value = DEFAULT_SENSITIVITY;
-    } else {
-        value = Math.round(value * 1000);
-    }
-    config['offscreen_sensitivity'] = value;
+    config['offscreen_sensitivity'] = sensitivity_input_value(document.getElementById('offscreen_sensitivity_input'));
 }
 
-function screens_onchange() {
-    for (let i = 0; i < 2; i++) {
-        for (const param of ['x', 'y', 'w', 'h']) {
-            let value = document.getElementById('screen' + i + '_' + param + '_input').value;
-            config['screens'][i][param] = (value === '' ? 0 : parseInt(value, 10));
-        }
-        let value = document.getElementById('screen' + i + '_sensitivity_input').value;
-        if (value === '') {
-            value = DEFAULT_SENSITIVITY;
-        } else {
-            value = Math.round(value * 1000);
-        }
-        config['screens'][i]['sensitivity'] = value;
+function report_priority_onchange(event) {
+    let value = parseInt(event.target.value, 10);
+    if (isNaN(value)) {
+        value = 0;
     }
+    value = Math.min(255, Math.max(0, value));
+    event.target.value = value;
+    config['report_priority'][event.target.dataset.report] = value;
+}
+
+function screen_param_onchange(screen, param, element) {
+    return function () {
+        screen[param] = (element.value === '' ? 0 : parseInt(element.value, 10));
+    };
+}
+
+function screen_sensitivity_onchange(screen, element) {
+    return function () {
+        screen['sensitivity'] = sensitivity_input_value(element);
+    };
+}
+
+function delete_screen(screen) {
+    return function () {
+        config['screens'] = config['screens'].filter(x => x !== screen);
+        set_screens_ui_state();
+    };
+}
+
+function add_screen_onclick() {
+    const last = config['screens'][config['screens'].length - 1];
+    config['screens'].push({
+        'x': last['x'] + last['w'],
+        'y': last['y'],
+        'w': last['w'],
+        'h': last['h'],
+        'sensitivity': last['sensitivity'],
+        'route': ROUTE_FORWARDER,
+        'forwarder_address': Math.max(config['screens'].length - 1, 0),
+        'hires_scroll': last['hires_scroll'],
+    });
+    set_screens_ui_state();
 }
 
 function load_example(n) {
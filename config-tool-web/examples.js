@@ -3,26 +3,37 @@ const examples = [
         'description': '16:10 screen side to side with a 3:2 screen',
         'config':
         {
-            "version": 4,
+            "version": 7,
             "unmapped_passthrough": true,
             "partial_scroll_timeout": 1000000,
             "interval_override": 0,
             "constraint_mode": 2,
             "offscreen_sensitivity": 4000,
+            "report_priority": {
+                "mouse": 1,
+                "keyboard": 0,
+                "consumer": 2
+            },
             "screens": [
                 {
                     "x": 0,
                     "y": 0,
                     "w": 14400000,
                     "h": 9000000,
-                    "sensitivity": 8000
+                    "sensitivity": 8000,
+                    "route": 0,
+                    "forwarder_address": 0,
+                    "hires_scroll": false
                 },
                 {
                     "x": 14400000,
                     "y": 0,
                     "w": 13500000,
                     "h": 9000000,
-                    "sensitivity": 8000
+                    "sensitivity": 8000,
+                    "route": 1,
+                    "forwarder_address": 0,
+                    "hires_scroll": false
                 }
             ],
             "mappings": [
@@ -33,26 +44,37 @@ const examples = [
         'description': 'two 16:9 screens, one on top of the other',
         'config':
         {
-            "version": 4,
+            "version": 7,
             "unmapped_passthrough": true,
             "partial_scroll_timeout": 1000000,
             "interval_override": 0,
             "constraint_mode": 2,
             "offscreen_sensitivity": 4000,
+            "report_priority": {
+                "mouse": 1,
+                "keyboard": 0,
+                "consumer": 2
+            },
             "screens": [
                 {
                     "x": 0,
                     "y": 0,
                     "w": 16000000,
                     "h": 9000000,
-                    "sensitivity": 4000
+                    "sensitivity": 4000,
+                    "route": 0,
+                    "forwarder_address": 0,
+                    "hires_scroll": false
                 },
                 {
                     "x": 0,
                     "y": 9000000,
                     "w": 16000000,
                     "h": 9000000,
-                    "sensitivity": 4000
+                    "sensitivity": 4000,
+                    "route": 1,
+                    "forwarder_address": 0,
+                    "hires_scroll": false
                 }
             ],
             "mappings": [
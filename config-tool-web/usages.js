@@ -146,6 +146,18 @@ const usages = {
     "0xfff10001": { 'name': 'Layer 1', 'class': 'other' },
     "0xfff10002": { 'name': 'Layer 2', 'class': 'other' },
     "0xfff10003": { 'name': 'Layer 3', 'class': 'other' },
+    "0xfff10004": { 'name': 'Layer 4', 'class': 'other' },
+    "0xfff10005": { 'name': 'Layer 5', 'class': 'other' },
+    "0xfff10006": { 'name': 'Layer 6', 'class': 'other' },
+    "0xfff10007": { 'name': 'Layer 7', 'class': 'other' },
+    "0xfff10008": { 'name': 'Layer 8', 'class': 'other' },
+    "0xfff10009": { 'name': 'Layer 9', 'class': 'other' },
+    "0xfff1000a": { 'name': 'Layer 10', 'class': 'other' },
+    "0xfff1000b": { 'name': 'Layer 11', 'class': 'other' },
+    "0xfff1000c": { 'name': 'Layer 12', 'class': 'other' },
+    "0xfff1000d": { 'name': 'Layer 13', 'class': 'other' },
+    "0xfff1000e": { 'name': 'Layer 14', 'class': 'other' },
+    "0xfff1000f": { 'name': 'Layer 15', 'class': 'other' },
     "0xfff20001": { 'name': 'Switch screen', 'class': 'other' },
 };
 
@@ -8,7 +8,7 @@ import json
 VENDOR_ID = 0xCAFE
 PRODUCT_ID = 0xBAF3
 
-CONFIG_VERSION = 4
+CONFIG_VERSION = 7
 CONFIG_SIZE = 32
 REPORT_ID_CONFIG = 100
 
@@ -17,8 +17,8 @@ GET_MAPPING = 6
 GET_SCREEN = 13
 
 UNMAPPED_PASSTHROUGH_FLAG = 0x01
-
-NSCREENS = 2
+LATE_MOTION_FLAG = 0x02
+HIRES_SCROLL_FLAG = 0x01
 
 
 def check_crc(buf, crc_):
@@ -48,18 +48,27 @@ data = device.get_feature_report(REPORT_ID_CONFIG, CONFIG_SIZE + 1)
     interval_override,
     constraint_mode,
     offscreen_sensitivity,
-    *_,
+    screen_count,
+    mouse_priority,
+    keyboard_priority,
+    consumer_priority,
     crc,
-) = struct.unpack("<BBBLLLLBBL4BL", data)
+) = struct.unpack("<BBBLLLLBBLBBBBL", data)
 check_crc(data, crc)
 
 config = {
     "version": version,
     "unmapped_passthrough": (flags & UNMAPPED_PASSTHROUGH_FLAG) != 0,
+    "late_motion": (flags & LATE_MOTION_FLAG) != 0,
     "partial_scroll_timeout": partial_scroll_timeout,
     "interval_override": interval_override,
     "constraint_mode": constraint_mode,
     "offscreen_sensitivity": offscreen_sensitivity,
+    "report_priority": {
+        "mouse": mouse_priority,
+        "keyboard": keyboard_priority,
+        "consumer": consumer_priority,
+    },
     "screens": [],
     "mappings": [],
 }
@@ -91,7 +100,7 @@ for i in range(mapping_count):
         }
     )
 
-for i in range(NSCREENS):
+for i in range(screen_count):
     data = struct.pack(
         "<BBBL22B", REPORT_ID_CONFIG, CONFIG_VERSION, GET_SCREEN, i, *([0] * 22)
     )
@@ -104,9 +113,12 @@ for i in range(NSCREENS):
         w,
         h,
         sensitivity,
+        route,
+        forwarder_address,
+        screen_flags,
         *_,
         crc,
-    ) = struct.unpack("<BLLLLL8BL", data)
+    ) = struct.unpack("<BLLLLLBBB5BL", data)
     check_crc(data, crc)
     config["screens"].append(
         {
@@ -115,6 +127,9 @@ for i in range(NSCREENS):
             "w": w,
             "h": h,
             "sensitivity": sensitivity,
+            "route": route,
+            "forwarder_address": forwarder_address,
+            "hires_scroll": (screen_flags & HIRES_SCROLL_FLAG) != 0,
         }
     )
 
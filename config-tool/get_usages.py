@@ -8,7 +8,7 @@ import json
 VENDOR_ID = 0xCAFE
 PRODUCT_ID = 0xBAF3
 
-CONFIG_VERSION = 4
+CONFIG_VERSION = 7
 CONFIG_SIZE = 32
 REPORT_ID_CONFIG = 100
 
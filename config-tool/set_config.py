@@ -9,7 +9,7 @@ import json
 VENDOR_ID = 0xCAFE
 PRODUCT_ID = 0xBAF3
 
-CONFIG_VERSION = 4
+CONFIG_VERSION = 7
 CONFIG_SIZE = 32
 REPORT_ID_CONFIG = 100
 
@@ -22,9 +22,12 @@ RESUME = 11
 SET_SCREEN = 12
 
 UNMAPPED_PASSTHROUGH_FLAG = 0x01
+LATE_MOTION_FLAG = 0x02
 STICKY_FLAG = 0x01
+HIRES_SCROLL_FLAG = 0x01
 
-NSCREENS = 2
+ROUTE_LOCAL_USB = 0
+ROUTE_FORWARDER = 1
 
 
 def check_crc(buf, crc_):
@@ -38,6 +41,19 @@ def add_crc(buf):
 
 config = json.load(sys.stdin)
 
+# the firmware clamps anything above this (65.535)
+MAX_SENSITIVITY = 65535
+
+for sensitivity in [config.get("offscreen_sensitivity", 1000)] + [
+    screen.get("sensitivity", 1000) for screen in config.get("screens", [])
+]:
+    if not 0 <= sensitivity <= MAX_SENSITIVITY:
+        raise Exception(
+            "sensitivity {} out of range, has to be between 0 and {}".format(
+                sensitivity, MAX_SENSITIVITY
+            )
+        )
+
 device = hid.Device(VENDOR_ID, PRODUCT_ID)
 
 data = struct.pack("<BBB26B", REPORT_ID_CONFIG, CONFIG_VERSION, SUSPEND, *([0] * 26))
@@ -46,14 +62,19 @@ device.send_feature_report(add_crc(data))
 version = config.get("version", CONFIG_VERSION)
 partial_scroll_timeout = config.get("partial_scroll_timeout", 1000000)
 unmapped_passthrough = config.get("unmapped_passthrough", True)
+late_motion = config.get("late_motion", False)
 interval_override = config.get("interval_override", 0)
 constraint_mode = config.get("constraint_mode", 0)
 offscreen_sensitivity = config.get("offscreen_sensitivity", 1000)
+screens = config.get("screens", [])
+report_priority = config.get("report_priority", {})
 
 flags = UNMAPPED_PASSTHROUGH_FLAG if unmapped_passthrough else 0
+if late_motion:
+    flags |= LATE_MOTION_FLAG
 
 data = struct.pack(
-    "<BBBBLBBL15B",
+    "<BBBBLBBLBBBB11B",
     REPORT_ID_CONFIG,
     CONFIG_VERSION,
     SET_CONFIG,
@@ -62,7 +83,11 @@ data = struct.pack(
     interval_override,
     constraint_mode,
     offscreen_sensitivity,
-    *([0] * 15)
+    max(len(screens), 1),
+    report_priority.get("mouse", 1),
+    report_priority.get("keyboard", 0),
+    report_priority.get("consumer", 2),
+    *([0] * 11)
 )
 device.send_feature_report(add_crc(data))
 
@@ -91,9 +116,9 @@ for mapping in config.get("mappings", []):
     )
     device.send_feature_report(add_crc(data))
 
-for i, screen in enumerate(config.get("screens", [])):
+for i, screen in enumerate(screens):
     data = struct.pack(
-        "<BBBBLLLLL5B",
+        "<BBBBLLLLLBBB2B",
         REPORT_ID_CONFIG,
         CONFIG_VERSION,
         SET_SCREEN,
@@ -103,7 +128,10 @@ for i, screen in enumerate(config.get("screens", [])):
         screen["w"],
         screen["h"],
         screen.get("sensitivity", 1000),
-        *([0] * 5)
+        screen.get("route", ROUTE_LOCAL_USB if i == 0 else ROUTE_FORWARDER),
+        screen.get("forwarder_address", max(i - 1, 0)),
+        HIRES_SCROLL_FLAG if screen.get("hires_scroll", False) else 0,
+        *([0] * 2)
     )
     device.send_feature_report(add_crc(data))
 
@@ -0,0 +1,125 @@
+#ifndef _BITS_H_
+#define _BITS_H_
+
+#include <stdint.h>
+
+#include "types.h"
+
+inline int8_t get_bit(const uint8_t* data, int len, uint16_t bitpos) {
+    int byte_no = bitpos / 8;
+    int bit_no = bitpos % 8;
+    if (byte_no < len) {
+        return (data[byte_no] & 1 << bit_no) ? 1 : 0;
+    }
+    return 0;
+}
+
+inline uint32_t get_bits(const uint8_t* data, int len, uint16_t bitpos, uint8_t size) {
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= get_bit(data, len, bitpos + i) << i;
+    }
+    return value;
+}
+
+inline void put_bit(uint8_t* data, int len, uint16_t bitpos, uint8_t value) {
+    int byte_no = bitpos / 8;
+    int bit_no = bitpos % 8;
+    if (byte_no < len) {
+        data[byte_no] &= ~(1 << bit_no);
+        data[byte_no] |= (value & 1) << bit_no;
+    }
+}
+
+inline void put_bits(uint8_t* data, int len, uint16_t bitpos, uint8_t size, uint32_t value) {
+    for (int i = 0; i < size; i++) {
+        put_bit(data, len, bitpos + i, (value >> i) & 1);
+    }
+}
+
+constexpr BitsKernel bits_kernel(uint16_t bitpos, uint8_t size) {
+    if ((size == 0) || (size > 32)) {
+        return BitsKernel::BITWISE;
+    }
+    if (size == 1) {
+        return BitsKernel::BIT;
+    }
+    if (bitpos % 8 == 0) {
+        switch (size) {
+            case 8:
+                return BitsKernel::U8;
+            case 16:
+                return BitsKernel::U16;
+            case 32:
+                return BitsKernel::U32;
+        }
+    }
+    return BitsKernel::GENERIC;
+}
+
+// Same as above, but a byte at a time (or just one bit) using the kernel picked
+// for the field. Fields that don't fit in the data (short reports) still go
+// through the bitwise versions.
+inline uint32_t get_bits(const uint8_t* data, int len, uint16_t bitpos, uint8_t size, BitsKernel kernel) {
+    if ((kernel == BitsKernel::BITWISE) || (bitpos + size > len * 8)) {
+        return get_bits(data, len, bitpos, size);
+    }
+    const uint8_t* p = data + bitpos / 8;
+    uint8_t shift = bitpos % 8;
+    switch (kernel) {
+        case BitsKernel::BIT:
+            return (p[0] >> shift) & 1;
+        case BitsKernel::U8:
+            return p[0];
+        case BitsKernel::U16:
+            return p[0] | (p[1] << 8);
+        case BitsKernel::U32:
+            return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+        default: {
+            uint64_t value = 0;
+            for (int i = 0; i < (shift + size + 7) / 8; i++) {
+                value |= (uint64_t) p[i] << (i * 8);
+            }
+            return (value >> shift) & (0xFFFFFFFF >> (32 - size));
+        }
+    }
+}
+
+inline void put_bits(uint8_t* data, int len, uint16_t bitpos, uint8_t size, uint32_t value, BitsKernel kernel) {
+    if ((kernel == BitsKernel::BITWISE) || (bitpos + size > len * 8)) {
+        put_bits(data, len, bitpos, size, value);
+        return;
+    }
+    uint8_t* p = data + bitpos / 8;
+    uint8_t shift = bitpos % 8;
+    switch (kernel) {
+        case BitsKernel::BIT:
+            p[0] = (p[0] & ~(1 << shift)) | ((value & 1) << shift);
+            break;
+        case BitsKernel::U32:
+            p[3] = value >> 24;
+            p[2] = value >> 16;
+            // fall through
+        case BitsKernel::U16:
+            p[1] = value >> 8;
+            // fall through
+        case BitsKernel::U8:
+            p[0] = value;
+            break;
+        default: {
+            int nbytes = (shift + size + 7) / 8;
+            uint64_t mask = (uint64_t) (0xFFFFFFFF >> (32 - size)) << shift;
+            uint64_t packed = 0;
+            for (int i = 0; i < nbytes; i++) {
+                packed |= (uint64_t) p[i] << (i * 8);
+            }
+            packed = (packed & ~mask) | (((uint64_t) value << shift) & mask);
+            for (int i = 0; i < nbytes; i++) {
+                p[i] = packed >> (i * 8);
+            }
+            break;
+        }
+    }
+}
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <unordered_set>
 
 #include <bsp/board.h>
@@ -15,17 +16,28 @@
 #include "our_descriptor.h"
 #include "remapper.h"
 
-const uint8_t CONFIG_VERSION = 4;
+const uint8_t CONFIG_VERSION = 7;
 
 const uint32_t PRESUMED_FLASH_SIZE = 2097152;
 const uint32_t CONFIG_OFFSET_IN_FLASH = (PRESUMED_FLASH_SIZE - FLASH_SECTOR_SIZE);
 const uint8_t* FLASH_CONFIG_IN_MEMORY = (((uint8_t*) XIP_BASE) + CONFIG_OFFSET_IN_FLASH);
 
 const uint8_t CONFIG_FLAG_UNMAPPED_PASSTHROUGH = 0x01;
+const uint8_t CONFIG_FLAG_LATE_MOTION = 0x02;
 
 ConfigCommand last_config_command = ConfigCommand::NO_COMMAND;
 uint32_t requested_index = 0;
 
+// Between SUSPEND and RESUME config changes are collected here and applied all
+// at once on RESUME. Input keeps going through the old config until then.
+bool staging = false;
+bool staged_config_valid = false;
+set_config_t staged_config;
+bool staged_mappings_valid = false;
+std::vector<mapping_config_t> staged_mappings;
+std::unordered_map<int8_t, screen_def_t> staged_screens;
+bool staged_persist = false;
+
 bool checksum_ok(const uint8_t* buffer, uint16_t data_size) {
     return crc32(buffer, data_size - 4) == ((crc32_t*) (buffer + data_size - 4))->crc32;
 }
@@ -34,15 +46,22 @@ bool version_ok(const uint8_t* buffer) {
     return ((set_feature_t*) buffer)->version == CONFIG_VERSION;
 }
 
+uint8_t valid_screen_count(uint8_t count) {
+    return std::clamp(count, (uint8_t) 1, (uint8_t) MAX_SCREENS);
+}
+
 void load_config() {
     if (checksum_ok(FLASH_CONFIG_IN_MEMORY, FLASH_SECTOR_SIZE) && version_ok(FLASH_CONFIG_IN_MEMORY)) {
         persist_config_t* config = (persist_config_t*) FLASH_CONFIG_IN_MEMORY;
         unmapped_passthrough = (config->flags & CONFIG_FLAG_UNMAPPED_PASSTHROUGH) != 0;
+        late_motion = (config->flags & CONFIG_FLAG_LATE_MOTION) != 0;
         partial_scroll_timeout = config->partial_scroll_timeout;
         interval_override = config->interval_override;
         constraint_mode = config->constraint_mode;
         screens[-1].sensitivity = config->offscreen_sensitivity;
-        for (uint8_t i = 0; i < NSCREENS; i++) {
+        screen_count = valid_screen_count(config->screen_count);
+        memcpy(report_priority, config->report_priority, sizeof(report_priority));
+        for (uint8_t i = 0; i < MAX_SCREENS; i++) {
             screens[i] = config->screens[i];
         }
         mapping_config_t* buffer_mappings = (mapping_config_t*) (FLASH_CONFIG_IN_MEMORY + sizeof(persist_config_t));
@@ -51,6 +70,7 @@ void load_config() {
         }
     }
     screens_updated();
+    report_priority_updated();
     set_mapping_from_config();
 }
 
@@ -60,13 +80,19 @@ void fill_get_config(get_config_t* config) {
     if (unmapped_passthrough) {
         config->flags |= CONFIG_FLAG_UNMAPPED_PASSTHROUGH;
     }
+    if (late_motion) {
+        config->flags |= CONFIG_FLAG_LATE_MOTION;
+    }
     config->partial_scroll_timeout = partial_scroll_timeout;
     config->mapping_count = config_mappings.size();
     config->our_usage_count = our_usages_rle.size();
+    update_their_usages_rle();
     config->their_usage_count = their_usages_rle.size();
     config->interval_override = interval_override;
     config->constraint_mode = constraint_mode;
     config->offscreen_sensitivity = screens[-1].sensitivity;
+    config->screen_count = screen_count;
+    memcpy(config->report_priority, report_priority, sizeof(report_priority));
 }
 
 void fill_persist_config(persist_config_t* config) {
@@ -75,12 +101,17 @@ void fill_persist_config(persist_config_t* config) {
     if (unmapped_passthrough) {
         config->flags |= CONFIG_FLAG_UNMAPPED_PASSTHROUGH;
     }
+    if (late_motion) {
+        config->flags |= CONFIG_FLAG_LATE_MOTION;
+    }
     config->partial_scroll_timeout = partial_scroll_timeout;
     config->mapping_count = config_mappings.size();
     config->interval_override = interval_override;
     config->constraint_mode = constraint_mode;
     config->offscreen_sensitivity = screens[-1].sensitivity;
-    for (uint8_t i = 0; i < NSCREENS; i++) {
+    config->screen_count = screen_count;
+    memcpy(config->report_priority, report_priority, sizeof(report_priority));
+    for (uint8_t i = 0; i < MAX_SCREENS; i++) {
         config->screens[i] = screens[i];
     }
 }
@@ -108,6 +139,7 @@ void persist_config() {
 void tud_mount_cb() {
     // reset hi-res scroll for when we reboot from Windows into Linux
     resolution_multiplier = 0;
+    resolution_multiplier_updated();
 }
 
 uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen) {
@@ -139,6 +171,7 @@ uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t
             }
             case ConfigCommand::GET_THEIR_USAGES: {
                 usages_list_t* returned_usages = (usages_list_t*) config_buffer;
+                update_their_usages_rle();
                 for (uint32_t i = 0; (i < NUSAGES_IN_PACKET) && (requested_index + i < their_usages_rle.size()); i++) {
                     returned_usages->usages[i] = their_usages_rle[requested_index + i];
                 }
@@ -146,7 +179,7 @@ uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t
             }
             case ConfigCommand::GET_SCREEN: {
                 screen_def_t* returned_screen = (screen_def_t*) config_buffer;
-                if (requested_index < NSCREENS) {
+                if (requested_index < MAX_SCREENS) {
                     *returned_screen = screens[requested_index];
                 }
             }
@@ -160,9 +193,63 @@ uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t
     return 0;
 }
 
+// Returns true if the screens need to be updated.
+bool apply_set_config(const set_config_t* config) {
+    unmapped_passthrough = (config->flags & CONFIG_FLAG_UNMAPPED_PASSTHROUGH) != 0;
+    late_motion = (config->flags & CONFIG_FLAG_LATE_MOTION) != 0;
+    partial_scroll_timeout = config->partial_scroll_timeout;
+    uint8_t prev_interval_override = interval_override;
+    interval_override = config->interval_override;
+    if (prev_interval_override != interval_override) {
+        interval_override_updated();
+    }
+    constraint_mode = config->constraint_mode;
+    screens[-1].sensitivity = config->offscreen_sensitivity;
+    offscreen_sensitivity_updated();
+    uint8_t prev_screen_count = screen_count;
+    screen_count = valid_screen_count(config->screen_count);
+    memcpy(report_priority, config->report_priority, sizeof(report_priority));
+    report_priority_updated();
+    return prev_screen_count != screen_count;
+}
+
+void clear_staged_config() {
+    staged_config_valid = false;
+    staged_mappings_valid = false;
+    staged_mappings.clear();
+    staged_screens.clear();
+    staged_persist = false;
+}
+
+void apply_staged_config() {
+    bool update_screens = false;
+    if (staged_config_valid) {
+        update_screens = apply_set_config(&staged_config);
+    }
+    for (auto const& [index, screen] : staged_screens) {
+        screens[index] = screen;
+        update_screens = true;
+    }
+    if (staged_mappings_valid) {
+        config_mappings.swap(staged_mappings);
+    }
+    if (update_screens) {
+        screens_updated();
+    }
+    if (staged_config_valid || staged_mappings_valid) {
+        set_mapping_from_config();
+    }
+    if (staged_persist) {
+        need_to_persist_config = true;
+    }
+
+    clear_staged_config();
+}
+
 void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize) {
     if (report_id == REPORT_ID_MULTIPLIER && bufsize >= 1) {
         memcpy(&resolution_multiplier, buffer, 1);
+        resolution_multiplier_updated();
     }
     if (report_id == REPORT_ID_CONFIG && bufsize >= CONFIG_SIZE) {
         if (checksum_ok(buffer, CONFIG_SIZE) && version_ok(buffer)) {
@@ -174,24 +261,36 @@ void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t rep
                     break;
                 case ConfigCommand::SET_CONFIG: {
                     set_config_t* config = (set_config_t*) ((set_feature_t*) buffer)->data;
-                    unmapped_passthrough = (config->flags & CONFIG_FLAG_UNMAPPED_PASSTHROUGH) != 0;
-                    partial_scroll_timeout = config->partial_scroll_timeout;
-                    uint8_t prev_interval_override = interval_override;
-                    interval_override = config->interval_override;
-                    if (prev_interval_override != interval_override) {
-                        interval_override_updated();
+                    if (staging) {
+                        staged_config = *config;
+                        staged_config_valid = true;
+                        break;
+                    }
+                    if (apply_set_config(config)) {
+                        screens_updated();
                     }
-                    constraint_mode = config->constraint_mode;
-                    screens[-1].sensitivity = config->offscreen_sensitivity;
                     set_mapping_from_config();
                     break;
                 }
                 case ConfigCommand::CLEAR_MAPPING:
+                    if (staging) {
+                        staged_mappings.clear();
+                        staged_mappings_valid = true;
+                        break;
+                    }
                     config_mappings.clear();
                     set_mapping_from_config();
                     break;
                 case ConfigCommand::ADD_MAPPING: {
                     mapping_config_t* mapping_config = (mapping_config_t*) ((set_feature_t*) buffer)->data;
+                    if (staging) {
+                        if (!staged_mappings_valid) {
+                            staged_mappings = config_mappings;
+                            staged_mappings_valid = true;
+                        }
+                        staged_mappings.push_back(*mapping_config);
+                        break;
+                    }
                     config_mappings.push_back(*mapping_config);
                     set_mapping_from_config();
                     break;
@@ -205,19 +304,31 @@ void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t rep
                     break;
                 }
                 case ConfigCommand::PERSIST_CONFIG:
+                    if (staging) {
+                        staged_persist = true;  // what gets persisted is the new config
+                        break;
+                    }
                     need_to_persist_config = true;
                     break;
                 case ConfigCommand::SUSPEND:
-                    suspended = true;
+                    // whatever a config tool that never got to RESUME left behind doesn't count
+                    clear_staged_config();
+                    staging = true;
                     break;
                 case ConfigCommand::RESUME:
-                    suspended = false;
-                    // XXX clear input_state, sticky_state, accumulated?
+                    staging = false;
+                    apply_staged_config();
                     break;
                 case ConfigCommand::SET_SCREEN: {
                     set_screen_t* set_screen = (set_screen_t*) ((set_feature_t*) buffer)->data;
-                    screens[set_screen->index] = set_screen->screen;
-                    screens_updated();
+                    if (set_screen->index < MAX_SCREENS) {
+                        if (staging) {
+                            staged_screens[set_screen->index] = set_screen->screen;
+                            break;
+                        }
+                        screens[set_screen->index] = set_screen->screen;
+                        screens_updated();
+                    }
                     break;
                 }
                 default:
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <algorithm>
 #include <deque>
+#include <unordered_set>
 
 #include "descriptor_parser.h"
 #include "globals.h"
@@ -19,20 +21,31 @@ const uint8_t HID_USAGE_MAXIMUM = 0x28;
 const uint8_t HID_LOGICAL_MINIMUM = 0x14;
 const uint8_t HID_LOGICAL_MAXIMUM = 0x24;
 
-void mark_usage(std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>& usage_map, uint32_t usage, uint8_t report_id, uint16_t bitpos, uint8_t size, bool is_relative, int32_t logical_minimum, bool is_array = false, uint32_t index = 0, uint32_t count = 0) {
+// A report only gets a given usage once, the first field that has it keeps it.
+// array_usages has the ones that array values took (report_id << 32 | usage).
+void mark_usage(std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>& usage_map, const std::unordered_set<uint64_t>& array_usages, uint32_t usage, uint8_t report_id, uint16_t bitpos, uint8_t size, bool is_relative, int32_t logical_minimum) {
+    if (array_usages.count(((uint64_t) report_id << 32) | usage)) {
+        return;
+    }
     usage_map[report_id].try_emplace(usage,
         (usage_def_t){
             .report_id = report_id,
             .size = size,
             .bitpos = bitpos,
             .is_relative = is_relative,
-            .is_array = is_array,
             .logical_minimum = logical_minimum,
-            .index = index,
-            .count = count,
         });
 }
 
+// Adds the next array value to the array, without a usage if the report already has it.
+void mark_array_usage(const std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>& usage_map, std::unordered_set<uint64_t>& array_usages, their_array_t& array, uint32_t usage) {
+    uint8_t report_id = array.def.report_id;
+    auto search = usage_map.find(report_id);
+    bool taken = ((search != usage_map.end()) && search->second.count(usage)) ||
+                 !array_usages.insert(((uint64_t) report_id << 32) | usage).second;
+    array.usages.push_back(taken ? 0 : usage);
+}
+
 void assign_interface_index(uint16_t interface) {
     if (interface_index.count(interface)) {
         return;
@@ -51,15 +64,18 @@ void assign_interface_index(uint16_t interface) {
 
 void parse_descriptor(uint16_t vendor_id, uint16_t product_id, const uint8_t* report_descriptor, int len, uint16_t interface) {
     mutex_enter_blocking(&their_usages_mutex);
-    parse_descriptor(their_usages[interface], has_report_id_theirs[interface], report_descriptor, len);
+    parse_descriptor(their_usages[interface], their_arrays[interface], has_report_id_theirs[interface], report_descriptor, len);
     apply_quirks(vendor_id, product_id, their_usages[interface], report_descriptor, len);
     assign_interface_index(interface);
+    interface_generation[interface_index[interface]]++;
     mutex_exit(&their_usages_mutex);
     their_descriptor_updated = true;
 }
 
-std::unordered_map<uint8_t, uint16_t> parse_descriptor(std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>& usage_map, bool& has_report_id, const uint8_t* report_descriptor, int len) {
+std::unordered_map<uint8_t, uint16_t> parse_descriptor(std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>& usage_map, std::vector<their_array_t>& arrays, bool& has_report_id, const uint8_t* report_descriptor, int len) {
     int idx = 0;
+    std::unordered_set<uint64_t> array_usages;
+    arrays.clear();
 
     uint8_t report_id = 0;
     std::unordered_map<uint8_t, uint16_t> bitpos;  // report_id -> bitpos
@@ -97,7 +113,7 @@ std::unordered_map<uint8_t, uint16_t> parse_descriptor(std::unordered_map<uint8_
                     if (usage_minimum && usage_maximum) {
                         uint32_t usage = usage_minimum;
                         for (uint32_t i = 0; i < report_count; i++) {
-                            mark_usage(usage_map, usage, report_id, bitpos[report_id], report_size, relative, logical_minimum);
+                            mark_usage(usage_map, array_usages, usage, report_id, bitpos[report_id], report_size, relative, logical_minimum);
                             if (usage < usage_maximum) {
                                 usage++;
                             }
@@ -110,17 +126,27 @@ std::unordered_map<uint8_t, uint16_t> parse_descriptor(std::unordered_map<uint8_
                                 usage = usages.front();
                                 usages.pop_front();
                             }
-                            mark_usage(usage_map, usage, report_id, bitpos[report_id], report_size, relative, logical_minimum);
+                            mark_usage(usage_map, array_usages, usage, report_id, bitpos[report_id], report_size, relative, logical_minimum);
                             bitpos[report_id] += report_size;
                         }
                     } else {
                         bitpos[report_id] += report_size * report_count;
                     }
                 } else if ((value & 0x03) == 0x00) {  // array
+                    their_array_t array = {
+                        .def = {
+                            .report_id = report_id,
+                            .size = (uint8_t) report_size,
+                            .bitpos = bitpos[report_id],
+                            .is_relative = relative,
+                            .logical_minimum = logical_minimum,
+                            .count = report_count,
+                        },
+                    };
                     if (usage_minimum && usage_maximum) {
                         uint32_t usage = usage_minimum;
                         for (int index = logical_minimum; index <= logical_maximum; index++) {
-                            mark_usage(usage_map, usage, report_id, bitpos[report_id], report_size, relative, logical_minimum, true, index, report_count);
+                            mark_array_usage(usage_map, array_usages, array, usage);
                             if (usage < usage_maximum) {
                                 usage++;
                             }
@@ -132,9 +158,12 @@ std::unordered_map<uint8_t, uint16_t> parse_descriptor(std::unordered_map<uint8_
                                 usage = usages.front();
                                 usages.pop_front();
                             }
-                            mark_usage(usage_map, usage, report_id, bitpos[report_id], report_size, relative, logical_minimum, true, index, report_count);
+                            mark_array_usage(usage_map, array_usages, array, usage);
                         }
                     }
+                    if (std::any_of(array.usages.begin(), array.usages.end(), [](uint32_t usage) { return usage != 0; })) {
+                        arrays.push_back(std::move(array));
+                    }
                     bitpos[report_id] += report_size * report_count;
                 } else {  // constant
                     bitpos[report_id] += report_size * report_count;
@@ -218,7 +247,9 @@ void clear_descriptor_data(uint8_t dev_addr) {
             uint8_t index = interface_index[dev_addr_interface];
             interface_index.erase(dev_addr_interface);
             interface_index_in_use &= ~(1 << index);
+            interface_generation[index]++;
 
+            their_arrays.erase(dev_addr_interface);
             it = their_usages.erase(it);
         } else {
             it++;
@@ -0,0 +1,92 @@
+#ifndef _FIXED_POINT_H_
+#define _FIXED_POINT_H_
+
+#include <stdint.h>
+
+// Mapped values are Q16.16, scalings come in the config as * 1000. A scaling
+// that is a multiple of 125 (so a multiple of 0.125) converts exactly and for
+// those the results are bit-identical to doing everything in units of 1/1000,
+// as long as no sum goes past +-32768 whole units. Everything else rounds the
+// scaling to the nearest 1/65536.
+
+const int32_t FIXED_ONE = 1 << 16;  // Q16.16
+
+const uint32_t MAX_SENSITIVITY = 0xFFFF;  // so that scale_movement() can stay in 32 bits
+
+inline int32_t saturate(int64_t value) {
+    if (value > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (value < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return value;
+}
+
+inline int32_t mul_saturating(int32_t a, int32_t b) {
+    return saturate((int64_t) a * b);
+}
+
+inline int32_t add_saturating(int32_t a, int32_t b) {
+    int32_t result;
+    if (__builtin_add_overflow(a, b, &result)) {
+        return (b > 0) ? INT32_MAX : INT32_MIN;
+    }
+    return result;
+}
+
+// scaling comes in the config as * 1000
+inline int32_t scaling_to_fixed(int32_t scaling) {
+    return saturate(((int64_t) scaling * FIXED_ONE + (scaling < 0 ? -500 : 500)) / 1000);
+}
+
+// Q16.16 mouse movement to screen units, rounded towards zero
+inline int32_t scale_movement(int32_t movement, uint32_t sensitivity) {
+    uint32_t abs_movement = (movement < 0) ? -(uint32_t) movement : movement;
+    uint32_t scaled = (abs_movement >> 16) * sensitivity + (((abs_movement & 0xFFFF) * sensitivity) >> 16);
+    return (movement < 0) ? -(int32_t) scaled : scaled;
+}
+
+// What local_coordinate() needs to know about a screen's width or height.
+// For a size of b bits, offset >> pre_shift has at most 16 bits and so does
+// reciprocal (2^(15 + b) / size, rounded down, up to 2^16), their product fits
+// in 32 bits.
+struct coordinate_scale_t {
+    uint32_t size;
+    uint32_t reciprocal;
+    uint8_t pre_shift;
+    uint8_t shift;
+};
+
+inline coordinate_scale_t coordinate_scale(uint32_t size) {
+    if (size == 0) {
+        return { 0, 0, 0, 0 };
+    }
+    uint8_t bits = 32 - __builtin_clz(size);
+    uint8_t pre_shift = (bits > 16) ? bits - 16 : 0;
+    return {
+        .size = size,
+        .reciprocal = (uint32_t) ((1ull << (15 + bits)) / size),
+        .pre_shift = pre_shift,
+        .shift = (uint8_t) (bits - pre_shift),
+    };
+}
+
+// Offset into a screen (0 to size - 1) to the 0..32767 range of our absolute
+// X/Y, offset * 32768 / size exactly for sizes below 2^30. The estimate is at
+// most 2 short, the remainder (which fits in 32 bits, so it can be worked out
+// modulo 2^32) says by how much.
+inline uint32_t local_coordinate(uint32_t offset, const coordinate_scale_t& scale) {
+    uint32_t result = ((offset >> scale.pre_shift) * scale.reciprocal) >> scale.shift;
+    uint32_t remainder = (offset << 15) - result * scale.size;
+    if (remainder >= scale.size) {
+        result++;
+        remainder -= scale.size;
+    }
+    if (remainder >= scale.size) {
+        result++;
+    }
+    return result;
+}
+
+#endif
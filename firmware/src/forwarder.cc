@@ -1,17 +1,106 @@
+#include <algorithm>
+
 #include <bsp/board.h>
 #include <tusb.h>
 
 #include "hardware/gpio.h"
+#include "pico/time.h"
 
+#include "bits.h"
+#include "our_descriptor.h"
+#include "our_descriptor_layout.h"
 #include "serial.h"
 
 #define FORWARDER_UART uart1
+#define FORWARDER_TX_PIN 8
 #define FORWARDER_RX_PIN 9
 
 bool led_state = false;
 
+// The remapper sends us hi-res scroll in FORWARDER_HIRES_MARKER frames. If our
+// host didn't enable it, we turn it into wheel clicks here and keep the rest
+// for the next report, unless the scrolling stopped for longer than the
+// timeout that came with the frame. Frames without the marker have wheel
+// clicks in them, if our host did enable hi-res those get scaled up.
+#define NSCROLLS 2
+constexpr our_usage_t OUR_SCROLLS[NSCROLLS] = { our_usage(V_SCROLL_USAGE), our_usage(H_SCROLL_USAGE) };
+const uint8_t SCROLL_RESOLUTION_BITMASKS[NSCROLLS] = { V_RESOLUTION_BITMASK, H_RESOLUTION_BITMASK };
+static_assert(OUR_SCROLLS[0].def.report_id && OUR_SCROLLS[1].def.report_id);
+
+uint8_t resolution_multiplier = 0;
+int32_t scroll_remainder[NSCROLLS];
+uint64_t last_scroll_us[NSCROLLS];
+
+void scale_down_scroll(uint8_t report_id, uint8_t* report, uint16_t len, uint32_t timeout_ms) {
+    for (uint8_t i = 0; i < NSCROLLS; i++) {
+        const usage_def_t& scroll = OUR_SCROLLS[i].def;
+        if ((scroll.report_id != report_id) || (resolution_multiplier & SCROLL_RESOLUTION_BITMASKS[i])) {
+            continue;
+        }
+        int32_t value = get_bits(report, len, scroll.bitpos, scroll.size, scroll.kernel);
+        if (value & (1 << (scroll.size - 1))) {
+            value |= 0xFFFFFFFF << scroll.size;
+        }
+        if (value == 0) {
+            continue;
+        }
+        // don't let what's left from scrolling one way eat into the other, or
+        // what's left from a while ago count towards a click now
+        uint64_t now = time_us_64();
+        if (((value < 0) != (scroll_remainder[i] < 0)) || (now - last_scroll_us[i] > timeout_ms * 1000ull)) {
+            scroll_remainder[i] = 0;
+        }
+        last_scroll_us[i] = now;
+        scroll_remainder[i] += value;
+        int32_t clicks = scroll_remainder[i] / RESOLUTION_MULTIPLIER;
+        scroll_remainder[i] -= clicks * RESOLUTION_MULTIPLIER;
+        put_bits(report, len, scroll.bitpos, scroll.size, clicks, scroll.kernel);
+    }
+}
+
+void scale_up_scroll(uint8_t report_id, uint8_t* report, uint16_t len) {
+    for (uint8_t i = 0; i < NSCROLLS; i++) {
+        const usage_def_t& scroll = OUR_SCROLLS[i].def;
+        if ((scroll.report_id != report_id) || !(resolution_multiplier & SCROLL_RESOLUTION_BITMASKS[i])) {
+            continue;
+        }
+        int32_t value = get_bits(report, len, scroll.bitpos, scroll.size, scroll.kernel);
+        if (value & (1 << (scroll.size - 1))) {
+            value |= 0xFFFFFFFF << scroll.size;
+        }
+        int32_t limit = (1 << (scroll.size - 1)) - 1;
+        put_bits(report, len, scroll.bitpos, scroll.size, std::clamp(value * RESOLUTION_MULTIPLIER, -limit, limit), scroll.kernel);
+    }
+}
+
 void serial_callback(const uint8_t* data, uint16_t len) {
-    tud_hid_report(data[0], data + 1, len - 1);
+    if (data[0] == FORWARDER_CHAIN_MARKER) {
+        if (len < 3) {
+            return;
+        }
+        if (data[1] > 1) {
+            static uint8_t buffer[SERIAL_MAX_PAYLOAD_SIZE + 32];
+            memcpy(buffer, data, len);
+            buffer[1]--;
+            serial_write(buffer, len, FORWARDER_UART);
+        } else {
+            serial_write(data + 2, len - 2, FORWARDER_UART);
+        }
+        return;
+    }
+    static uint8_t report[SERIAL_MAX_PAYLOAD_SIZE + 32];
+    if (data[0] == FORWARDER_HIRES_MARKER) {
+        if (len < 4) {
+            return;
+        }
+        memcpy(report, data + 4, len - 4);
+        scale_down_scroll(data[3], report, len - 4, data[1] | (data[2] << 8));
+        tud_hid_report(data[3], report, len - 4);
+    } else {
+        memcpy(report, data + 1, len - 1);
+        scale_up_scroll(data[0], report, len - 1);
+        tud_hid_report(data[0], report, len - 1);
+    }
     board_led_write(led_state);
     led_state = !led_state;
 }
@@ -19,6 +108,7 @@ void serial_callback(const uint8_t* data, uint16_t len) {
 void forwarder_serial_init() {
     uart_init(FORWARDER_UART, FORWARDER_BAUDRATE);
     uart_set_translate_crlf(FORWARDER_UART, false);
+    gpio_set_function(FORWARDER_TX_PIN, GPIO_FUNC_UART);
     gpio_set_function(FORWARDER_RX_PIN, GPIO_FUNC_UART);
 }
 
@@ -35,9 +125,20 @@ int main() {
     return 0;
 }
 
+void tud_mount_cb() {
+    resolution_multiplier = 0;
+}
+
 void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize) {
+    if (report_id == REPORT_ID_MULTIPLIER && bufsize >= 1) {
+        memcpy(&resolution_multiplier, buffer, 1);
+    }
 }
 
 uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen) {
+    if (report_id == REPORT_ID_MULTIPLIER && reqlen >= 1) {
+        memcpy(buffer, &resolution_multiplier, 1);
+        return 1;
+    }
     return 0;
 }
@@ -3,20 +3,25 @@
 mutex_t their_usages_mutex;
 
 std::unordered_map<uint16_t, std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>> their_usages;
+std::unordered_map<uint16_t, std::vector<their_array_t>> their_arrays;
 
 std::unordered_map<uint16_t, bool> has_report_id_theirs;
 
 std::unordered_map<uint16_t, uint8_t> interface_index;
 uint32_t interface_index_in_use = 0;
 
+interface_plan_t interface_plans[MAX_INTERFACES];
+uint8_t interface_plan_count = 0;
+volatile uint32_t interface_generation[MAX_INTERFACES];
+
 std::vector<usage_rle_t> our_usages_rle;
 std::vector<usage_rle_t> their_usages_rle;
 
 volatile bool need_to_persist_config = false;
 volatile bool their_descriptor_updated = false;
-volatile bool suspended = false;
 
 bool unmapped_passthrough = true;
+bool late_motion = false;
 uint32_t partial_scroll_timeout = 1000000;
 std::vector<mapping_config_t> config_mappings;
 
@@ -24,8 +29,12 @@ uint8_t resolution_multiplier = 0;
 
 std::unordered_map<int8_t, screen_def_t> screens = {
     { -1, (screen_def_t){ .sensitivity = 4000 } },
-    { 0, (screen_def_t){ .x = 0, .y = 0, .w = 16000000, .h = 9000000, .sensitivity = 4000 } },
-    { 1, (screen_def_t){ .x = 16000000, .y = 0, .w = 16000000, .h = 9000000, .sensitivity = 4000 } },
+    { 0, (screen_def_t){ .x = 0, .y = 0, .w = 16000000, .h = 9000000, .sensitivity = 4000, .route = ScreenRoute::LOCAL_USB } },
+    { 1, (screen_def_t){ .x = 16000000, .y = 0, .w = 16000000, .h = 9000000, .sensitivity = 4000, .route = ScreenRoute::FORWARDER } },
 };
+uint8_t screen_count = 2;
+
+// keyboard before mouse so that modifiers are already down when a click arrives
+uint8_t report_priority[MAX_INPUT_REPORT_ID] = { 1, 0, 2 };  // mouse, keyboard, consumer
 
 ConstraintMode constraint_mode = ConstraintMode::VISIBLE;
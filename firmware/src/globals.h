@@ -11,26 +11,38 @@
 extern mutex_t their_usages_mutex;
 
 extern std::unordered_map<uint16_t, std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>> their_usages;  // dev_addr+interface -> report_id -> usage -> usage_def
+extern std::unordered_map<uint16_t, std::vector<their_array_t>> their_arrays;                                           // dev_addr+interface -> ...
 
 extern std::unordered_map<uint16_t, bool> has_report_id_theirs;  // dev_addr+interface -> bool
 
 extern std::unordered_map<uint16_t, uint8_t> interface_index;  // dev_addr+interface -> unique 0-31 integer
 extern uint32_t interface_index_in_use;                        // bit mask
 
+// What handle_received_report() does with reports from each interface, see
+// intern_usages(). Only used on the core that handles reports, the other core
+// just bumps interface_generation when an interface's descriptor data changes
+// so that its plan isn't used anymore.
+extern interface_plan_t interface_plans[MAX_INTERFACES];
+extern uint8_t interface_plan_count;
+extern volatile uint32_t interface_generation[MAX_INTERFACES];  // interface index -> ...
+
 extern std::vector<usage_rle_t> our_usages_rle;
 extern std::vector<usage_rle_t> their_usages_rle;
 
 extern volatile bool need_to_persist_config;
 extern volatile bool their_descriptor_updated;
-extern volatile bool suspended;
 
 extern bool unmapped_passthrough;
+extern bool late_motion;
 extern uint32_t partial_scroll_timeout;
 extern std::vector<mapping_config_t> config_mappings;
 
 extern uint8_t resolution_multiplier;
 
 extern std::unordered_map<int8_t, screen_def_t> screens;
+extern uint8_t screen_count;
+
+extern uint8_t report_priority[MAX_INPUT_REPORT_ID];  // report_id - 1 -> priority, lower goes out first
 
 extern ConstraintMode constraint_mode;
 
@@ -6,12 +6,141 @@
 #define CONFIG_SIZE 32
 #define RESOLUTION_MULTIPLIER 120
 
+// bits of the REPORT_ID_MULTIPLIER feature report
+#define V_RESOLUTION_BITMASK (1 << 0)
+#define H_RESOLUTION_BITMASK (1 << 2)
+
+#define V_SCROLL_USAGE 0x00010038
+#define H_SCROLL_USAGE 0x000C0238
+
 #define REPORT_ID_MULTIPLIER 99
 #define REPORT_ID_CONFIG 100
 
+#define REPORT_ID_MOUSE 1
+#define REPORT_ID_KEYBOARD 2
+#define REPORT_ID_CONSUMER 3
+
 #define MAX_INPUT_REPORT_ID 3
 
-extern const uint8_t our_report_descriptor[];
-extern const uint32_t our_report_descriptor_length;
+// this is in the header so that our_descriptor_layout.h can parse it at compile time
+inline constexpr uint8_t our_report_descriptor[] = {
+    0x05, 0x01,                   // Usage Page (Generic Desktop Ctrls)
+    0x09, 0x02,                   // Usage (Mouse)
+    0xA1, 0x01,                   // Collection (Application)
+    0x05, 0x01,                   //   Usage Page (Generic Desktop Ctrls)
+    0x09, 0x02,                   //   Usage (Mouse)
+    0xA1, 0x02,                   //   Collection (Logical)
+    0x85, REPORT_ID_MOUSE,        //     Report ID (REPORT_ID_MOUSE)
+    0x09, 0x01,                   //     Usage (Pointer)
+    0xA1, 0x00,                   //     Collection (Physical)
+    0x05, 0x09,                   //       Usage Page (Button)
+    0x19, 0x01,                   //       Usage Minimum (0x01)
+    0x29, 0x08,                   //       Usage Maximum (0x08)
+    0x95, 0x08,                   //       Report Count (8)
+    0x75, 0x01,                   //       Report Size (1)
+    0x25, 0x01,                   //       Logical Maximum (1)
+    0x81, 0x02,                   //       Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+    0x05, 0x01,                   //       Usage Page (Generic Desktop Ctrls)
+    0x09, 0x30,                   //       Usage (X)
+    0x09, 0x31,                   //       Usage (Y)
+    0x95, 0x02,                   //       Report Count (2)
+    0x75, 0x10,                   //       Report Size (16)
+    0x16, 0x00, 0x00,             //       Logical Minimum (0)
+    0x26, 0xFF, 0x7F,             //       Logical Maximum (32767)
+    0x81, 0x02,                   //       Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+    0xA1, 0x02,                   //       Collection (Logical)
+    0x85, REPORT_ID_MULTIPLIER,   //         Report ID (REPORT_ID_MULTIPLIER)
+    0x09, 0x48,                   //         Usage (Resolution Multiplier)
+    0x95, 0x01,                   //         Report Count (1)
+    0x75, 0x02,                   //         Report Size (2)
+    0x15, 0x00,                   //         Logical Minimum (0)
+    0x25, 0x01,                   //         Logical Maximum (1)
+    0x35, 0x01,                   //         Physical Minimum (1)
+    0x45, RESOLUTION_MULTIPLIER,  //         Physical Maximum (RESOLUTION_MULTIPLIER)
+    0xB1, 0x02,                   //         Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+    0x85, REPORT_ID_MOUSE,        //         Report ID (REPORT_ID_MOUSE)
+    0x09, 0x38,                   //         Usage (Wheel)
+    0x35, 0x00,                   //         Physical Minimum (0)
+    0x45, 0x00,                   //         Physical Maximum (0)
+    0x16, 0x00, 0x80,             //         Logical Minimum (-32768)
+    0x26, 0xFF, 0x7F,             //         Logical Maximum (32767)
+    0x75, 0x10,                   //         Report Size (16)
+    0x81, 0x06,                   //         Input (Data,Var,Rel,No Wrap,Linear,Preferred State,No Null Position)
+    0xC0,                         //       End Collection
+    0xA1, 0x02,                   //       Collection (Logical)
+    0x85, REPORT_ID_MULTIPLIER,   //         Report ID (REPORT_ID_MULTIPLIER)
+    0x09, 0x48,                   //         Usage (Resolution Multiplier)
+    0x75, 0x02,                   //         Report Size (2)
+    0x15, 0x00,                   //         Logical Minimum (0)
+    0x25, 0x01,                   //         Logical Maximum (1)
+    0x35, 0x01,                   //         Physical Minimum (1)
+    0x45, RESOLUTION_MULTIPLIER,  //         Physical Maximum (RESOLUTION_MULTIPLIER)
+    0xB1, 0x02,                   //         Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+    0x35, 0x00,                   //         Physical Minimum (0)
+    0x45, 0x00,                   //         Physical Maximum (0)
+    0x75, 0x04,                   //         Report Size (4)
+    0xB1, 0x03,                   //         Feature (Const,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+    0x85, REPORT_ID_MOUSE,        //         Report ID (REPORT_ID_MOUSE)
+    0x05, 0x0C,                   //         Usage Page (Consumer)
+    0x16, 0x00, 0x80,             //         Logical Minimum (-32768)
+    0x26, 0xFF, 0x7F,             //         Logical Maximum (32767)
+    0x75, 0x10,                   //         Report Size (16)
+    0x0A, 0x38, 0x02,             //         Usage (AC Pan)
+    0x81, 0x06,                   //         Input (Data,Var,Rel,No Wrap,Linear,Preferred State,No Null Position)
+    0xC0,                         //       End Collection
+    0xC0,                         //     End Collection
+    0xC0,                         //   End Collection
+    0xC0,                         // End Collection
+
+    0x05, 0x01,                // Usage Page (Generic Desktop Ctrls)
+    0x09, 0x06,                // Usage (Keyboard)
+    0xA1, 0x01,                // Collection (Application)
+    0x85, REPORT_ID_KEYBOARD,  //   Report ID (REPORT_ID_KEYBOARD)
+    0x05, 0x07,                //   Usage Page (Kbrd/Keypad)
+    0x19, 0xE0,                //   Usage Minimum (0xE0)
+    0x29, 0xE7,                //   Usage Maximum (0xE7)
+    0x15, 0x00,                //   Logical Minimum (0)
+    0x25, 0x01,                //   Logical Maximum (1)
+    0x75, 0x01,                //   Report Size (1)
+    0x95, 0x08,                //   Report Count (8)
+    0x81, 0x02,                //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+    0x19, 0x04,                //   Usage Minimum (0x04)
+    0x29, 0x73,                //   Usage Maximum (0x73)
+    0x95, 0x70,                //   Report Count (112)
+    0x81, 0x02,                //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+    0xC0,                      // End Collection
+
+    0x05, 0x0C,                // Usage Page (Consumer)
+    0x09, 0x01,                // Usage (Consumer Control)
+    0xA1, 0x01,                // Collection (Application)
+    0x85, REPORT_ID_CONSUMER,  //   Report ID (REPORT_ID_CONSUMER)
+    0x15, 0x00,                //   Logical Minimum (0)
+    0x25, 0x01,                //   Logical Maximum (1)
+    0x09, 0xB5,                //   Usage (Scan Next Track)
+    0x09, 0xB6,                //   Usage (Scan Previous Track)
+    0x09, 0xB7,                //   Usage (Stop)
+    0x09, 0xCD,                //   Usage (Play/Pause)
+    0x09, 0xE2,                //   Usage (Mute)
+    0x09, 0xE9,                //   Usage (Volume Increment)
+    0x09, 0xEA,                //   Usage (Volume Decrement)
+    0x05, 0x0B,                //   Usage Page (Telephony)
+    0x09, 0x2F,                //   Usage (Phone Mute)
+    0x75, 0x01,                //   Report Size (1)
+    0x95, 0x08,                //   Report Count (8)
+    0x81, 0x02,                //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+    0xC0,                      // End Collection
+
+    0x06, 0x00, 0xFF,        // Usage Page (Vendor Defined 0xFF00)
+    0x09, 0x20,              // Usage (0x20)
+    0xA1, 0x01,              // Collection (Application)
+    0x09, 0x20,              //   Usage (0x20)
+    0x85, REPORT_ID_CONFIG,  //   Report ID (REPORT_ID_CONFIG)
+    0x75, 0x08,              //   Report Size (8)
+    0x95, CONFIG_SIZE,       //   Report Count (CONFIG_SIZE)
+    0xB1, 0x02,              //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+    0xC0,                    // End Collection
+};
+
+inline constexpr uint32_t our_report_descriptor_length = sizeof(our_report_descriptor);
 
 #endif
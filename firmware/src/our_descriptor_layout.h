@@ -0,0 +1,269 @@
+#ifndef _OUR_DESCRIPTOR_LAYOUT_H_
+#define _OUR_DESCRIPTOR_LAYOUT_H_
+
+#include <stdint.h>
+
+#include "bits.h"
+#include "our_descriptor.h"
+#include "types.h"
+
+// Our descriptor never changes, so unlike theirs it gets parsed at compile time.
+// The rules are the same as in parse_descriptor(), but only for the parts of HID
+// that our descriptor uses. Anything else makes the walk fail and the
+// static_asserts below catch it.
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);  // masks are built a word at a time
+
+struct our_usage_t {
+    uint32_t usage;
+    usage_def_t def;
+};
+
+template <typename Mark>
+constexpr bool walk_our_descriptor(Mark&& mark, uint16_t (&bitpos)[MAX_INPUT_REPORT_ID + 1]) {
+    const uint8_t HID_INPUT = 0x80;
+    const uint8_t HID_OUTPUT = 0x90;
+    const uint8_t HID_FEATURE = 0xB0;
+    const uint8_t HID_COLLECTION = 0xA0;
+    const uint8_t HID_USAGE_PAGE = 0x04;
+    const uint8_t HID_REPORT_SIZE = 0x74;
+    const uint8_t HID_REPORT_ID = 0x84;
+    const uint8_t HID_REPORT_COUNT = 0x94;
+    const uint8_t HID_USAGE = 0x08;
+    const uint8_t HID_USAGE_MINIMUM = 0x18;
+    const uint8_t HID_USAGE_MAXIMUM = 0x28;
+    const uint8_t HID_LOGICAL_MINIMUM = 0x14;
+    const uint8_t MAX_USAGES = 16;
+
+    uint8_t report_id = 0;
+    uint32_t report_size = 0;
+    uint32_t report_count = 0;
+    uint32_t usage_page = 0;
+    uint32_t usages[MAX_USAGES] = {};
+    uint8_t nusages = 0;
+    uint32_t usage_minimum = 0;
+    uint32_t usage_maximum = 0;
+    int32_t logical_minimum = 0;
+
+    uint32_t idx = 0;
+    while (idx < our_report_descriptor_length) {
+        uint8_t item = our_report_descriptor[idx] & 0xFC;
+        uint8_t item_size = our_report_descriptor[idx] & 0x03;
+        if (item_size == 3) {
+            item_size = 4;
+        }
+        uint32_t value = 0;
+        idx++;
+        for (int i = 0; i < item_size; i++) {
+            value |= our_report_descriptor[idx++] << (i * 8);
+        }
+
+        switch (item) {
+            case HID_INPUT: {
+                if ((report_id == 0) || (report_id > MAX_INPUT_REPORT_ID)) {
+                    return false;
+                }
+                bool relative = value & (1 << 2);
+                if ((value & 0x03) == 0x02) {  // scalar
+                    if (usage_minimum && usage_maximum) {
+                        uint32_t usage = usage_minimum;
+                        for (uint32_t i = 0; i < report_count; i++) {
+                            mark(usage, report_id, bitpos[report_id], report_size, relative, logical_minimum);
+                            if (usage < usage_maximum) {
+                                usage++;
+                            }
+                            bitpos[report_id] += report_size;
+                        }
+                    } else if (nusages > 0) {
+                        uint32_t usage = 0;
+                        for (uint32_t i = 0; i < report_count; i++) {
+                            if (i < nusages) {
+                                usage = usages[i];
+                            }
+                            mark(usage, report_id, bitpos[report_id], report_size, relative, logical_minimum);
+                            bitpos[report_id] += report_size;
+                        }
+                    } else {
+                        bitpos[report_id] += report_size * report_count;
+                    }
+                } else if ((value & 0x03) == 0x00) {  // array
+                    if ((usage_minimum && usage_maximum) || (nusages > 0)) {
+                        return false;  // we don't use these
+                    }
+                    bitpos[report_id] += report_size * report_count;
+                } else {  // constant
+                    bitpos[report_id] += report_size * report_count;
+                }
+
+                nusages = 0;
+                usage_minimum = 0;
+                usage_maximum = 0;
+                break;
+            }
+            case HID_COLLECTION:
+            case HID_OUTPUT:
+            case HID_FEATURE:
+                nusages = 0;
+                usage_minimum = 0;
+                usage_maximum = 0;
+                break;
+            case HID_USAGE_PAGE:
+                usage_page = value;
+                break;
+            case HID_REPORT_SIZE:
+                report_size = value;
+                break;
+            case HID_REPORT_ID:
+                report_id = value;
+                break;
+            case HID_REPORT_COUNT:
+                report_count = value;
+                break;
+            case HID_USAGE:
+                if (nusages == MAX_USAGES) {
+                    return false;
+                }
+                usages[nusages++] = item_size <= 2 ? usage_page << 16 | value : value;
+                break;
+            case HID_USAGE_MINIMUM:
+                usage_minimum = item_size <= 2 ? usage_page << 16 | value : value;
+                break;
+            case HID_USAGE_MAXIMUM:
+                usage_maximum = item_size <= 2 ? usage_page << 16 | value : value;
+                break;
+            case HID_LOGICAL_MINIMUM:
+                logical_minimum = value;
+                if (logical_minimum & (1 << (item_size * 8 - 1))) {
+                    logical_minimum |= 0xFFFFFFFF << item_size * 8;
+                }
+                break;
+        }
+    }
+
+    for (auto& position : bitpos) {
+        if (position % 8 != 0) {
+            return false;
+        }
+        position /= 8;  // final bit position becomes report size in bytes
+    }
+
+    return true;
+}
+
+struct our_descriptor_stats_t {
+    bool ok;
+    uint16_t usage_count;
+    uint16_t relative_usage_count;
+    uint16_t report_sizes[MAX_INPUT_REPORT_ID + 1];
+};
+
+constexpr our_descriptor_stats_t count_our_usages() {
+    our_descriptor_stats_t stats = {};
+    stats.ok = walk_our_descriptor(
+        [&](uint32_t, uint8_t, uint16_t, uint8_t, bool is_relative, int32_t) {
+            stats.usage_count++;
+            stats.relative_usage_count += is_relative;
+        },
+        stats.report_sizes);
+    return stats;
+}
+
+inline constexpr our_descriptor_stats_t OUR_DESCRIPTOR_STATS = count_our_usages();
+static_assert(OUR_DESCRIPTOR_STATS.ok, "our descriptor uses something walk_our_descriptor() doesn't handle");
+
+constexpr uint8_t max_report_words() {
+    uint8_t words = 1;
+    for (auto size : OUR_DESCRIPTOR_STATS.report_sizes) {
+        words = ((size + 3) / 4 > words) ? (size + 3) / 4 : words;
+    }
+    return words;
+}
+
+// report buffers are word aligned and padded to a whole number of words
+inline constexpr uint8_t OUR_REPORT_WORDS = max_report_words();
+
+// report_id -> mask, zero in the padding
+struct our_masks_t {
+    uint32_t words[MAX_INPUT_REPORT_ID + 1][OUR_REPORT_WORDS];
+
+    constexpr const uint32_t* operator[](uint8_t report_id) const {
+        return words[report_id];
+    }
+
+    constexpr void mark(uint8_t report_id, uint16_t bitpos, uint8_t size) {
+        for (uint16_t bit = bitpos; bit < bitpos + size; bit++) {
+            words[report_id][bit / 32] |= 1u << (bit % 32);
+        }
+    }
+
+    constexpr void clear(uint8_t report_id, uint16_t bitpos, uint8_t size) {
+        for (uint16_t bit = bitpos; bit < bitpos + size; bit++) {
+            words[report_id][bit / 32] &= ~(1u << (bit % 32));
+        }
+    }
+};
+
+struct our_layout_t {
+    our_usage_t usages[OUR_DESCRIPTOR_STATS.usage_count];  // in descriptor order
+    our_usage_t relative_usages[OUR_DESCRIPTOR_STATS.relative_usage_count];
+    uint16_t report_sizes[MAX_INPUT_REPORT_ID + 1];
+    uint8_t report_words[MAX_INPUT_REPORT_ID + 1];
+    our_masks_t masks_relative;
+    our_masks_t masks_absolute;
+};
+
+constexpr our_layout_t make_our_layout() {
+    our_layout_t layout = {};
+    uint16_t n = 0;
+    uint16_t n_relative = 0;
+    walk_our_descriptor(
+        [&](uint32_t usage, uint8_t report_id, uint16_t bitpos, uint8_t size, bool is_relative, int32_t logical_minimum) {
+            our_usage_t our_usage = {};
+            our_usage.usage = usage;
+            our_usage.def.report_id = report_id;
+            our_usage.def.size = size;
+            our_usage.def.bitpos = bitpos;
+            our_usage.def.is_relative = is_relative;
+            our_usage.def.logical_minimum = logical_minimum;
+            our_usage.def.kernel = bits_kernel(bitpos, size);
+            layout.usages[n++] = our_usage;
+            if (is_relative) {
+                layout.relative_usages[n_relative++] = our_usage;
+                layout.masks_relative.mark(report_id, bitpos, size);
+            } else {
+                layout.masks_absolute.mark(report_id, bitpos, size);
+            }
+        },
+        layout.report_sizes);
+    for (uint8_t report_id = 0; report_id <= MAX_INPUT_REPORT_ID; report_id++) {
+        layout.report_words[report_id] = (layout.report_sizes[report_id] + 3) / 4;
+    }
+    return layout;
+}
+
+inline constexpr our_layout_t OUR_LAYOUT = make_our_layout();
+
+constexpr bool our_usages_unique() {
+    // parse_descriptor() keeps the first one, here we just don't allow them
+    for (uint16_t i = 0; i < OUR_DESCRIPTOR_STATS.usage_count; i++) {
+        for (uint16_t j = i + 1; j < OUR_DESCRIPTOR_STATS.usage_count; j++) {
+            if (OUR_LAYOUT.usages[i].usage == OUR_LAYOUT.usages[j].usage) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(our_usages_unique(), "a usage appears more than once in our descriptor");
+
+constexpr our_usage_t our_usage(uint32_t usage) {
+    for (auto const& our_usage : OUR_LAYOUT.usages) {
+        if (our_usage.usage == usage) {
+            return our_usage;
+        }
+    }
+    return {};
+}
+
+#endif
@@ -73,8 +73,7 @@ bool pio_usb_task(report_handler_t report_handler) {
                 int len = pio_usb_get_in_data(ep, temp, sizeof(temp));
 
                 if (len > 0) {
-                    report_handler(temp, len, (uint16_t) (device->address << 8) | ep->interface);
-                    return true;
+                    return report_handler(temp, len, (uint16_t) (device->address << 8) | ep->interface);
                 }
             }
         }
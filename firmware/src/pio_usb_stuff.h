@@ -34,7 +34,7 @@ extern "C" {
 #include "pio_usb.h"
 }
 
-typedef void (*report_handler_t)(const uint8_t* report, int len, uint16_t interface);
+typedef bool (*report_handler_t)(const uint8_t* report, int len, uint16_t interface);
 
 void launch_pio_usb();
 bool pio_usb_task(report_handler_t);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -10,56 +11,147 @@
 #include "hardware/uart.h"
 #include "pico/stdio.h"
 
+#include "bits.h"
 #include "config.h"
 #include "crc.h"
-#include "descriptor_parser.h"
+#include "fixed_point.h"
 #include "globals.h"
 #include "our_descriptor.h"
+#include "our_descriptor_layout.h"
 #include "remapper.h"
 #include "serial.h"
+#include "timer_wheel.h"
 
 #define FORWARDER_UART uart1
 #define FORWARDER_TX_PIN 20
 
 const uint8_t MAPPING_FLAG_STICKY = 0x01;
 
-const uint8_t V_RESOLUTION_BITMASK = (1 << 0);
-const uint8_t H_RESOLUTION_BITMASK = (1 << 2);
-const uint32_t V_SCROLL_USAGE = 0x00010038;
-const uint32_t H_SCROLL_USAGE = 0x000C0238;
+const uint8_t OP_FLAG_STICKY = 0x01;
+const uint8_t OP_FLAG_SOURCE_RELATIVE = 0x02;
+const uint8_t OP_FLAG_ACCUMULATE = 0x04;  // relative target or cursor movement
+
+const uint8_t EXTRACT_FLAG_SIGNED = 0x01;
+const uint8_t EXTRACT_FLAG_RELATIVE = 0x02;
+const uint8_t EXTRACT_FLAG_UPDATE_ALL = 0x04;  // array slots that something else can change between reports
+const uint8_t EXTRACT_FLAG_PRIMED = 0x08;      // array_presence is valid
+
 const uint32_t MOUSE_X_USAGE = 0x00010030;
 const uint32_t MOUSE_Y_USAGE = 0x00010031;
 const uint32_t SWITCH_SCREEN_USAGE = 0xFFF20001;
 
-const uint8_t NLAYERS = 4;
+const uint8_t NLAYERS = 16;
 const uint32_t LAYERS_USAGE_PAGE = 0xFFF10000;
 
+const uint8_t EDGE_LEFT = 0;
+const uint8_t EDGE_RIGHT = 1;
+const uint8_t EDGE_TOP = 2;
+const uint8_t EDGE_BOTTOM = 3;
+const uint8_t NEDGES = 4;
+
 const std::unordered_map<uint32_t, uint8_t> resolution_multiplier_masks = {
     { V_SCROLL_USAGE, V_RESOLUTION_BITMASK },
     { H_SCROLL_USAGE, H_RESOLUTION_BITMASK },
 };
 
+// Forwarders that can take it (SCREEN_FLAG_HIRES_FORWARDER) get hi-res scroll,
+// they turn it back into wheel clicks themselves if their host didn't enable
+// it. The others get wheel clicks, older forwarders pass reports on as they are.
+const uint8_t FORWARDER_RESOLUTION_MULTIPLIER = V_RESOLUTION_BITMASK | H_RESOLUTION_BITMASK;
+constexpr uint8_t SCROLL_REPORT_IDS[] = { our_usage(V_SCROLL_USAGE).def.report_id, our_usage(H_SCROLL_USAGE).def.report_id };
+
 std::unordered_map<uint32_t, std::vector<map_source_t>> reverse_mapping;  // target -> sources list
+bool mapping_stale = false;  // reverse_mapping changed since the mapping program was compiled
+
+// The mapping program is split by how often things need to be evaluated.
+// Ops with relative sources only do something when the source changed,
+// absolute->relative (auto-repeat) ops run on every tick and absolute
+// targets are only re-evaluated when one of their sources changed.
+std::vector<map_op_t> mapping_program;      // relative sources, accumulating targets
+std::vector<map_op_t> auto_repeat_program;  // absolute or sticky sources, accumulating targets
+std::vector<map_op_t> absolute_program;     // absolute targets, grouped by target
+std::vector<uint16_t> absolute_target_starts;  // absolute target -> index into absolute_program (plus end)
+std::vector<uint16_t> dependents_starts;       // slot -> index into dependents (plus end)
+std::vector<uint16_t> dependents;              // absolute targets
+bool evaluate_all_targets = true;
 
-std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>> our_usages;  // report_id -> usage -> usage_def
 std::unordered_map<uint32_t, usage_def_t> our_usages_flat;
 
-std::vector<uint32_t> layer_triggering_stickies;
-std::vector<uint64_t> sticky_usages;  // non-layer triggering, layer << 32 | usage
-std::vector<uint64_t> screen_switching_usages;
+// these use the source_slot, sticky_slot and layer fields of map_op_t
+std::vector<map_op_t> layer_triggering_stickies;
+std::vector<map_op_t> sticky_usages;  // non-layer triggering
+std::vector<map_op_t> screen_switching_usages;
+std::vector<map_op_t> layer_triggers;  // layer is the triggered layer
+
+constexpr our_usage_t OUR_MOUSE_X = our_usage(MOUSE_X_USAGE);
+constexpr our_usage_t OUR_MOUSE_Y = our_usage(MOUSE_Y_USAGE);
+static_assert(OUR_MOUSE_X.def.report_id && (OUR_MOUSE_X.def.report_id == OUR_MOUSE_Y.def.report_id));
+
+constexpr our_masks_t make_edge_masks() {
+    our_masks_t masks = OUR_LAYOUT.masks_absolute;
+    for (auto const& cursor : { OUR_MOUSE_X, OUR_MOUSE_Y }) {
+        masks.clear(cursor.def.report_id, cursor.def.bitpos, cursor.def.size);
+    }
+    return masks;
+}
 
 // report_id -> ...
-uint8_t* reports[MAX_INPUT_REPORT_ID + 1];
-uint8_t* prev_reports[MAX_INPUT_REPORT_ID + 1];
-uint8_t* report_masks_relative[MAX_INPUT_REPORT_ID + 1];
-uint8_t* report_masks_absolute[MAX_INPUT_REPORT_ID + 1];
-uint16_t report_sizes[MAX_INPUT_REPORT_ID + 1];
+// Reports and masks are stored as words (padded with zeros at the end) so that
+// they can be compared a word at a time. Everything but the reports themselves
+// comes from our_descriptor_layout.h.
+uint32_t reports[MAX_INPUT_REPORT_ID + 1][OUR_REPORT_WORDS];
+uint32_t* prev_reports[MAX_INPUT_REPORT_ID + 1];  // last queued, usually points into a queue slot
+uint32_t prev_storage[MAX_INPUT_REPORT_ID + 1][OUR_REPORT_WORDS];  // where prev_reports go when their slot is reused
+bool reports_waiting = false;  // queue_reports() left some behind because a queue was full
+constexpr const our_masks_t& report_masks_relative = OUR_LAYOUT.masks_relative;
+constexpr const our_masks_t& report_masks_absolute = OUR_LAYOUT.masks_absolute;
+constexpr our_masks_t report_masks_edge = make_edge_masks();  // absolute minus cursor position
+constexpr const uint16_t (&report_sizes)[MAX_INPUT_REPORT_ID + 1] = OUR_LAYOUT.report_sizes;
+constexpr const uint8_t (&report_words)[MAX_INPUT_REPORT_ID + 1] = OUR_LAYOUT.report_words;
 
 #define OR_BUFSIZE 8
-uint8_t outgoing_reports[OR_BUFSIZE][CFG_TUD_HID_EP_BUFSIZE + 2];
-uint8_t or_head = 0;
-uint8_t or_tail = 0;
-uint8_t or_items = 0;
+// Button and key changes can't be merged into each other like motion can, so
+// there's room for more of them to wait for a slow host.
+#define EDGE_BUFSIZE 32
+
+// queue slot layout: screen, room for forwarder frame headers, report_id, report
+const uint8_t SLOT_SCREEN = 0;
+const uint8_t SLOT_REPORT_ID = 7;
+const uint8_t SLOT_REPORT = 8;
+static_assert(SLOT_REPORT % 4 == 0);
+static_assert(SLOT_REPORT_ID - SLOT_SCREEN - 1 >= 2 + 3);  // chain header, hi-res header
+const uint8_t SLOT_WORDS = (SLOT_REPORT + CFG_TUD_HID_EP_BUFSIZE) / 4;
+
+template <uint8_t SIZE>
+struct queue_storage_t {
+    uint32_t reports[SIZE][SLOT_WORDS];
+    uint32_t enqueued_at[SIZE];
+    uint32_t changes[SIZE][OUR_REPORT_WORDS];  // edge bits a queued report changes, see queue_edge()
+};
+
+struct outgoing_queue_t {
+    uint32_t (*const reports)[SLOT_WORDS];
+    uint32_t* const enqueued_at;
+    uint32_t (*const changes)[OUR_REPORT_WORDS];
+    const uint8_t size;
+    uint8_t head = 0;
+    uint8_t tail = 0;
+    uint8_t items = 0;
+    // since last print_stats()
+    uint32_t sent = 0;
+    uint32_t latency_sum = 0;
+    uint32_t latency_max = 0;
+    uint32_t merged = 0;    // reports that went into one that was already queued
+    uint32_t deferred = 0;  // times the queue was full and reports had to wait
+    uint32_t dropped = 0;   // button or key changes that didn't fit, see queue_report()
+};
+
+// Reports that change buttons or keys go in their own queue that is drained
+// first so that they don't have to wait for queued motion.
+queue_storage_t<EDGE_BUFSIZE> edge_storage;
+queue_storage_t<OR_BUFSIZE> motion_storage;
+outgoing_queue_t edge_queue = { edge_storage.reports, edge_storage.enqueued_at, edge_storage.changes, EDGE_BUFSIZE };
+outgoing_queue_t motion_queue = { motion_storage.reports, motion_storage.enqueued_at, motion_storage.changes, OR_BUFSIZE };
 
 // We need a certain part of mapping processing (absolute->relative mappings) to
 // happen exactly once per millisecond. This variable keeps track of whether we
@@ -67,106 +159,704 @@ uint8_t or_items = 0;
 // start-of-frame from USB host.
 volatile bool tick_pending;
 
-std::vector<uint8_t> report_ids;
+std::vector<uint8_t> report_ids;  // sorted by report_priority
+
+// report_id -> since last print_stats()
+uint32_t report_sent[MAX_INPUT_REPORT_ID + 1];
+uint32_t report_latency_sum[MAX_INPUT_REPORT_ID + 1];
+uint32_t report_latency_max[MAX_INPUT_REPORT_ID + 1];
+
+// Every usage that we can see (ours, theirs and mapping sources) gets a dense
+// slot number when the mappings or their descriptors change, so that the
+// per-usage state can live in plain arrays.
+std::unordered_map<uint32_t, uint16_t> usage_slots;
+std::unordered_map<uint64_t, uint16_t> sticky_slots;  // layer << 32 | usage -> sticky slot
 
-// usage -> ...
-std::unordered_map<uint32_t, int32_t> input_state;
-std::unordered_map<uint32_t, int32_t> prev_input_state;
-std::unordered_map<uint64_t, int32_t> sticky_state;  // layer << 32 | usage -> state
-std::unordered_map<uint32_t, int32_t> accumulated;   // * 1000
+// slot -> ...
+std::vector<int32_t> input_state;
+std::vector<int32_t> accumulated;  // Q16.16
 
-std::vector<uint32_t> relative_usages;
+// bitsets over slots
+std::vector<uint32_t> dirty_slots;   // set by read_input() when a value changes
+std::vector<uint32_t> active_slots;  // input_state != 0
+std::vector<uint32_t> prev_active_slots;
+std::vector<uint32_t> rising_slots;
+
+// bitset over sticky slots
+std::vector<uint32_t> sticky_state;
+
+// bitset over absolute targets
+std::vector<uint32_t> dirty_targets;
+
+// map_op_t::scroll_index -> ...
+std::vector<uint32_t> scroll_sources;     // usage
+std::vector<int32_t> accumulated_scroll;  // Q16.16
+timer_wheel_t scroll_timers;  // when to drop a partial lo-res scroll, advanced on every tick
+std::vector<uint16_t> scroll_target_slots;
+
+uint32_t layer_mask = 1;
+static_assert(NLAYERS <= 32);
+
+std::vector<uint16_t> relative_slots;
 std::unordered_set<uint32_t> relative_usage_set;
+std::vector<usage_def_t> accumulated_targets;
 
-std::unordered_map<uint32_t, int32_t> accumulated_scroll;
-std::unordered_map<uint32_t, uint64_t> last_scroll_timestamp;
+uint16_t mouse_x_slot;
+uint16_t mouse_y_slot;
 
 bool led_state;
 uint64_t next_print = 0;
 uint32_t reports_received;
 uint32_t reports_sent;
 
-int64_t cursor_x = 0;
-int64_t cursor_y = 0;
+int32_t cursor_x = 0;
+int32_t cursor_y = 0;
 
 int8_t active_screen = 0;
 
-int64_t bounds_min_x;
-int64_t bounds_max_x;
-int64_t bounds_min_y;
-int64_t bounds_max_y;
+int32_t bounds_min_x;
+int32_t bounds_max_x;
+int32_t bounds_min_y;
+int32_t bounds_max_y;
+
+// derived from screens by screens_updated()
+screen_params_t screen_params[MAX_SCREENS];
+uint32_t offscreen_sensitivity;
+// screen, edge -> screens that can be reached by crossing that edge (and no other), lowest index first
+// all screens share one coordinate space so there's no coordinate mapping to do across an edge
+std::vector<int8_t> screens_across[MAX_SCREENS][NEDGES];
+
+// zero width or height, the cursor can't be on it
+inline bool screen_empty(uint8_t screen) {
+    return (screen_params[screen].x == screen_params[screen].x_end) || (screen_params[screen].y == screen_params[screen].y_end);
+}
+
+// Empty screens are skipped, if they're all empty the cursor isn't on any screen.
+void move_cursor_to_center(int8_t screen) {
+    for (uint8_t i = 0; i < screen_count; i++) {
+        int8_t candidate = (screen + i) % screen_count;
+        if (!screen_empty(candidate)) {
+            cursor_x = screen_params[candidate].x + (screen_params[candidate].x_end - screen_params[candidate].x) / 2;
+            cursor_y = screen_params[candidate].y + (screen_params[candidate].y_end - screen_params[candidate].y) / 2;
+            active_screen = candidate;
+            return;
+        }
+    }
+    active_screen = -1;
+}
 
-int32_t handle_scroll(uint32_t source_usage, uint32_t target_usage, int32_t movement) {
+inline uint8_t screen_resolution_multiplier(int8_t screen) {
+    return (screen != -1) ? screen_params[screen].resolution_multiplier : resolution_multiplier;
+}
+
+int32_t handle_scroll(const map_op_t& op, int32_t movement) {
     int32_t ret = 0;
-    if (resolution_multiplier & resolution_multiplier_masks.at(target_usage)) {  // hi-res
-        ret = movement;
+    if (screen_resolution_multiplier(active_screen) & op.resolution_mask) {  // hi-res
+        ret = mul_saturating(movement, RESOLUTION_MULTIPLIER);
     } else {  // lo-res
-        if (movement != 0) {
-            last_scroll_timestamp[source_usage] = time_us_64();
-            accumulated_scroll[source_usage] += movement;
-            int ticks = accumulated_scroll[source_usage] / (1000 * RESOLUTION_MULTIPLIER);
-            accumulated_scroll[source_usage] -= ticks * (1000 * RESOLUTION_MULTIPLIER);
-            ret = ticks * 1000;
+        int32_t& accumulated_val = accumulated_scroll[op.scroll_index];
+        accumulated_val = add_saturating(accumulated_val, movement);
+        // dividing by a power of two is just a shift, no call into the divider
+        int32_t ticks = accumulated_val / FIXED_ONE;
+        accumulated_val -= ticks * FIXED_ONE;
+        ret = ticks * FIXED_ONE;
+        if (accumulated_val != 0) {
+            // ticks are milliseconds
+            timer_schedule(scroll_timers, op.scroll_index, (partial_scroll_timeout + 999) / 1000);
         } else {
-            if ((accumulated_scroll[source_usage] != 0) &&
-                (time_us_64() - last_scroll_timestamp[source_usage] > partial_scroll_timeout)) {
-                accumulated_scroll[source_usage] = 0;
-            }
+            timer_cancel(scroll_timers, op.scroll_index);
         }
     }
     return ret;
 }
 
-inline int8_t get_bit(const uint8_t* data, int len, uint16_t bitpos) {
-    int byte_no = bitpos / 8;
-    int bit_no = bitpos % 8;
-    if (byte_no < len) {
-        return (data[byte_no] & 1 << bit_no) ? 1 : 0;
-    }
-    return 0;
+inline bool bitset_test(const std::vector<uint32_t>& bitset, uint16_t n) {
+    return bitset[n / 32] & (1 << (n % 32));
 }
 
-inline uint32_t get_bits(const uint8_t* data, int len, uint16_t bitpos, uint8_t size) {
-    uint32_t value = 0;
-    for (int i = 0; i < size; i++) {
-        value |= get_bit(data, len, bitpos + i) << i;
+inline void bitset_set(std::vector<uint32_t>& bitset, uint16_t n, bool value = true) {
+    if (value) {
+        bitset[n / 32] |= 1 << (n % 32);
+    } else {
+        bitset[n / 32] &= ~(1 << (n % 32));
     }
-    return value;
 }
 
-inline void put_bit(uint8_t* data, int len, uint16_t bitpos, uint8_t value) {
-    int byte_no = bitpos / 8;
-    int bit_no = bitpos % 8;
-    if (byte_no < len) {
-        data[byte_no] &= ~(1 << bit_no);
-        data[byte_no] |= (value & 1) << bit_no;
-    }
+inline void bitset_toggle(std::vector<uint32_t>& bitset, uint16_t n) {
+    bitset[n / 32] ^= 1 << (n % 32);
 }
 
-inline void put_bits(uint8_t* data, int len, uint16_t bitpos, uint8_t size, uint32_t value) {
-    for (int i = 0; i < size; i++) {
-        put_bit(data, len, bitpos + i, (value >> i) & 1);
-    }
+inline uint32_t* slot_report(uint32_t* slot) {
+    return slot + SLOT_REPORT / 4;
 }
 
 bool needs_to_be_sent(uint8_t report_id) {
-    uint8_t* report = reports[report_id];
-    uint8_t* prev_report = prev_reports[report_id];
-    uint8_t* relative = report_masks_relative[report_id];
-    uint8_t* absolute = report_masks_absolute[report_id];
+    uint32_t* report = reports[report_id];
+    uint32_t* prev_report = prev_reports[report_id];
+    const uint32_t* relative = report_masks_relative[report_id];
+    const uint32_t* absolute = report_masks_absolute[report_id];
 
-    for (int i = 0; i < report_sizes[report_id]; i++) {
-        if ((report[i] & relative[i]) || ((report[i] & absolute[i]) != (prev_report[i] & absolute[i]))) {
+    for (int i = 0; i < report_words[report_id]; i++) {
+        if ((report[i] & relative[i]) || ((report[i] ^ prev_report[i]) & absolute[i])) {
             return true;
         }
     }
     return false;
 }
 
-void set_mapping_from_config() {
-    std::unordered_set<uint32_t> layer_triggering_sticky_set;
-    std::unordered_set<uint64_t> sticky_usage_set;
+bool is_edge(uint8_t report_id) {
+    uint32_t* report = reports[report_id];
+    uint32_t* prev_report = prev_reports[report_id];
+    const uint32_t* edge = report_masks_edge[report_id];
+
+    for (int i = 0; i < report_words[report_id]; i++) {
+        if ((report[i] ^ prev_report[i]) & edge[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reports are built directly in the free slot at the tail of the queue, commit()
+// then makes it part of the queue (and what the next report is compared against).
+uint32_t* reserve(outgoing_queue_t& queue, int8_t screen, uint8_t report_id) {
+    uint32_t* slot = queue.reports[queue.tail];
+    for (auto id : report_ids) {
+        if (prev_reports[id] == slot_report(slot)) {
+            memcpy(prev_storage[id], prev_reports[id], report_words[id] * 4);
+            prev_reports[id] = prev_storage[id];
+        }
+    }
+    ((uint8_t*) slot)[SLOT_SCREEN] = screen;
+    ((uint8_t*) slot)[SLOT_REPORT_ID] = report_id;
+    return slot_report(slot);
+}
+
+void commit(outgoing_queue_t& queue) {
+    uint32_t* slot = queue.reports[queue.tail];
+    prev_reports[((uint8_t*) slot)[SLOT_REPORT_ID]] = slot_report(slot);
+    queue.enqueued_at[queue.tail] = time_us_32();
+    queue.tail = (queue.tail + 1) % queue.size;
+    queue.items++;
+}
+
+uint64_t sticky_key(uint32_t target_usage, uint32_t source_usage, uint8_t layer) {
+    // layer triggering stickies work on all layers so their state isn't per layer
+    if ((target_usage & 0xFFFF0000) == LAYERS_USAGE_PAGE) {
+        return source_usage;
+    }
+    return ((uint64_t) layer << 32) | source_usage;
+}
+
+// How many of their usage definitions (across all interfaces) have a given
+// usage and how many of those are relative. These and relative_usage_set are
+// updated one interface at a time, see update_their_usage_refs().
+struct usage_refs_t {
+    uint16_t count;
+    uint16_t relative_count;
+};
+
+struct counted_interface_t {
+    uint8_t index;        // interface_index
+    uint32_t generation;  // interface_generation[index]
+    std::vector<std::pair<uint32_t, bool>> usages;  // usage, is_relative
+};
+
+std::unordered_map<uint32_t, usage_refs_t> their_usage_refs;
+std::unordered_map<uint16_t, counted_interface_t> counted_interfaces;  // dev_addr+interface -> what it added to their_usage_refs
+bool their_usages_rle_stale = false;
+
+// Returns true if a usage appeared or went away or its relative_usage_set
+// membership changed.
+bool count_their_usages(const counted_interface_t& counted, int16_t delta) {
+    bool changed = false;
+    for (auto const& [usage, is_relative] : counted.usages) {
+        usage_refs_t& refs = their_usage_refs[usage];
+        if (refs.count == 0) {
+            their_usages_rle_stale = true;
+            changed = true;
+        }
+        refs.count += delta;
+        if (is_relative) {
+            refs.relative_count += delta;
+            if (refs.relative_count == 0) {
+                changed |= relative_usage_set.erase(usage) > 0;
+            } else {
+                changed |= relative_usage_set.insert(usage).second;
+            }
+        }
+        if (refs.count == 0) {
+            their_usage_refs.erase(usage);
+            their_usages_rle_stale = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Only interfaces that were added, removed or parsed again since the last
+// time are looked at. Returns true if that changed which usages there are
+// or which of them are relative. Must be called with their_usages_mutex held.
+bool update_their_usage_refs() {
+    bool changed = false;
+    for (auto it = counted_interfaces.begin(); it != counted_interfaces.end();) {
+        auto const& [interface, counted] = *it;
+        if (their_usages.count(interface) &&
+            (counted.index == interface_index[interface]) &&
+            (counted.generation == interface_generation[counted.index])) {
+            it++;
+            continue;
+        }
+        changed |= count_their_usages(counted, -1);
+        it = counted_interfaces.erase(it);
+    }
+
+    for (auto const& [interface, report_id_usage_map] : their_usages) {
+        if (counted_interfaces.count(interface)) {
+            continue;
+        }
+        counted_interface_t& counted = counted_interfaces[interface];
+        counted.index = interface_index[interface];
+        counted.generation = interface_generation[counted.index];
+        for (auto const& [report_id, usage_map] : report_id_usage_map) {
+            for (auto const& [usage, usage_def] : usage_map) {
+                counted.usages.push_back({ usage, usage_def.is_relative });
+            }
+        }
+        for (auto const& array : their_arrays[interface]) {
+            for (auto const& usage : array.usages) {
+                if (usage != 0) {
+                    counted.usages.push_back({ usage, array.def.is_relative });
+                }
+            }
+        }
+        changed |= count_their_usages(counted, 1);
+    }
+    return changed;
+}
+
+std::vector<uint32_t> array_scratch;  // presence bitmap of the array being read
+
+void build_interface_plan(interface_plan_t& plan, uint16_t interface, const std::unordered_map<uint8_t, std::unordered_map<uint32_t, usage_def_t>>& report_id_usage_map, const std::vector<their_array_t>& arrays) {
+    plan.interface = interface;
+    plan.has_report_id = has_report_id_theirs[interface];
+    plan.index = interface_index[interface];
+    plan.index_mask = 1 << plan.index;
+    plan.generation = interface_generation[plan.index];
+    plan.ops.clear();
+    plan.report_starts.clear();
+    plan.array_ops.clear();
+    plan.array_report_starts.clear();
+    plan.array_slots.clear();
+    plan.array_presence.clear();
+    plan.raw_reports.clear();
+    plan.shared_slots = false;
+    plan.last_report_id = 0;
+    plan.received = 0;
+    plan.duplicates = 0;
+
+    std::vector<uint8_t> plan_report_ids;
+    std::unordered_map<uint16_t, uint8_t> slot_uses;
+    for (auto const& [report_id, usage_map] : report_id_usage_map) {
+        plan_report_ids.push_back(report_id);
+        for (auto const& [usage, usage_def] : usage_map) {
+            slot_uses[usage_slots[usage]]++;
+        }
+    }
+    for (auto const& array : arrays) {
+        plan_report_ids.push_back(array.def.report_id);
+        for (auto const& usage : array.usages) {
+            if (usage != 0) {
+                slot_uses[usage_slots[usage]]++;
+            }
+        }
+    }
+    std::sort(plan_report_ids.begin(), plan_report_ids.end());
+    plan_report_ids.erase(std::unique(plan_report_ids.begin(), plan_report_ids.end()), plan_report_ids.end());
+    plan.raw_reports.resize(plan_report_ids.empty() ? 0 : plan_report_ids.back() + 1);
+
+    for (auto report_id : plan_report_ids) {
+        plan.report_starts.resize(report_id + 1, plan.ops.size());
+        plan.array_report_starts.resize(report_id + 1, plan.array_ops.size());
+        raw_report_cache_t& raw_report = plan.raw_reports[report_id];
+
+        // a report with only arrays in it doesn't have any usages of its own
+        static const std::unordered_map<uint32_t, usage_def_t> no_usages;
+        auto search = report_id_usage_map.find(report_id);
+        const auto& usage_map = (search != report_id_usage_map.end()) ? search->second : no_usages;
+        for (auto const& [usage, usage_def] : usage_map) {
+            extract_op_t op = {
+                .bitpos = usage_def.bitpos,
+                .size = usage_def.size,
+                .kernel = bits_kernel(usage_def.bitpos, usage_def.size),
+                .slot = usage_slots[usage],
+                .flags = 0,
+            };
+            if (usage_def.logical_minimum < 0) {
+                op.flags |= EXTRACT_FLAG_SIGNED;
+            }
+            if (usage_def.is_relative) {
+                op.flags |= EXTRACT_FLAG_RELATIVE;
+                raw_report.relative_mask.resize(std::max(raw_report.relative_mask.size(), (size_t) (op.bitpos + op.size + 7) / 8));
+                put_bits(raw_report.relative_mask.data(), raw_report.relative_mask.size(), op.bitpos, op.size, 0xFFFFFFFF);
+            }
+            if (slot_uses[op.slot] > 1) {
+                plan.shared_slots = true;
+            }
+            plan.ops.push_back(op);
+        }
+        std::sort(plan.ops.begin() + plan.report_starts[report_id], plan.ops.end(), [](const extract_op_t& a, const extract_op_t& b) {
+            return a.bitpos < b.bitpos;
+        });
+
+        for (auto const& array : arrays) {
+            if (array.def.report_id != report_id) {
+                continue;
+            }
+            array_extract_op_t op = {
+                .bitpos = array.def.bitpos,
+                .size = array.def.size,
+                .kernel = bits_kernel(array.def.bitpos, array.def.size),
+                .count = array.def.count,
+                .first_value = (uint32_t) array.def.logical_minimum,
+                .nvalues = (uint32_t) array.usages.size(),
+                .slots_start = (uint32_t) plan.array_slots.size(),
+                .presence_start = (uint32_t) plan.array_presence.size(),
+                .flags = 0,
+            };
+            if (array.def.is_relative) {
+                op.flags |= EXTRACT_FLAG_RELATIVE;
+                raw_report.cacheable = false;  // a zero in a relative array can still mean something
+            }
+            uint32_t nwords = (op.nvalues + 31) / 32;
+            plan.array_slots.resize(op.slots_start + nwords * 32, NO_SLOT);
+            plan.array_presence.resize(op.presence_start + nwords, 0);
+            for (uint32_t i = 0; i < op.nvalues; i++) {
+                uint32_t usage = array.usages[i];
+                if (usage == 0) {
+                    continue;
+                }
+                uint16_t slot = usage_slots[usage];
+                plan.array_slots[op.slots_start + i] = slot;
+                // relative slots get cleared every tick, other usages in the same
+                // interface can write to the same bit
+                if ((slot_uses[slot] > 1) || relative_usage_set.count(usage)) {
+                    op.flags |= EXTRACT_FLAG_UPDATE_ALL;
+                }
+                if (slot_uses[slot] > 1) {
+                    plan.shared_slots = true;
+                }
+            }
+            if (array_scratch.size() < nwords) {
+                array_scratch.resize(nwords);
+            }
+            plan.array_ops.push_back(op);
+        }
+    }
+    plan.report_starts.push_back(plan.ops.size());
+    plan.array_report_starts.push_back(plan.array_ops.size());
+}
+
+inline bool plan_current(const interface_plan_t& plan) {
+    auto search = interface_index.find(plan.interface);
+    return their_usages.count(plan.interface) &&
+           (search != interface_index.end()) && (search->second == plan.index) &&
+           (plan.generation == interface_generation[plan.index]);
+}
+
+// Drops the plans of interfaces that went away or were parsed again and
+// builds the missing ones. The others stay as they are, so this is only
+// enough when usage slots didn't change. Must be called with
+// their_usages_mutex held.
+void update_interface_plans() {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < interface_plan_count; i++) {
+        if (plan_current(interface_plans[i])) {
+            if (kept != i) {
+                std::swap(interface_plans[kept], interface_plans[i]);  // keeps the vectors' memory around
+            }
+            kept++;
+        }
+    }
+    interface_plan_count = kept;
+
+    for (auto const& [interface, report_id_usage_map] : their_usages) {
+        if (interface_plan_count == MAX_INTERFACES) {
+            break;
+        }
+        bool planned = false;
+        for (uint8_t i = 0; i < kept; i++) {
+            if (interface_plans[i].interface == interface) {
+                planned = true;
+                break;
+            }
+        }
+        if (!planned) {
+            build_interface_plan(interface_plans[interface_plan_count++], interface, report_id_usage_map, their_arrays[interface]);
+        }
+    }
+}
+
+// Must be called with their_usages_mutex held and their_usage_refs up to date.
+void intern_usages() {
+    std::set<uint32_t> usages;
+    std::set<uint64_t> sticky_keys;
+
+    for (auto const& [usage, usage_def] : our_usages_flat) {
+        usages.insert(usage);
+    }
+    for (auto const& [target, sources] : reverse_mapping) {
+        for (auto const& map_source : sources) {
+            usages.insert(map_source.usage);
+            if (map_source.sticky) {
+                sticky_keys.insert(sticky_key(target, map_source.usage, map_source.layer));
+            }
+        }
+    }
+
+    for (auto const& [usage, refs] : their_usage_refs) {
+        usages.insert(usage);
+    }
+
+    std::unordered_map<uint32_t, uint16_t> new_usage_slots;
+    std::vector<int32_t> new_input_state(usages.size());
+    std::vector<uint32_t> new_active_slots((usages.size() + 31) / 32);
+    std::vector<uint32_t> new_prev_active_slots((usages.size() + 31) / 32);
+    std::vector<int32_t> new_accumulated(usages.size());
+
+    // state carries over for usages that were already there
+    for (auto const& usage : usages) {
+        uint16_t slot = new_usage_slots.size();
+        new_usage_slots[usage] = slot;
+        auto search = usage_slots.find(usage);
+        if (search != usage_slots.end()) {
+            uint16_t old_slot = search->second;
+            new_input_state[slot] = input_state[old_slot];
+            bitset_set(new_active_slots, slot, input_state[old_slot] != 0);
+            bitset_set(new_prev_active_slots, slot, bitset_test(prev_active_slots, old_slot));
+            new_accumulated[slot] = accumulated[old_slot];
+        }
+    }
+
+    std::unordered_map<uint64_t, uint16_t> new_sticky_slots;
+    std::vector<uint32_t> new_sticky_state((sticky_keys.size() + 31) / 32);
+
+    for (auto const& key : sticky_keys) {
+        uint16_t sticky_slot = new_sticky_slots.size();
+        new_sticky_slots[key] = sticky_slot;
+        auto search = sticky_slots.find(key);
+        if (search != sticky_slots.end()) {
+            bitset_set(new_sticky_state, sticky_slot, bitset_test(sticky_state, search->second));
+        }
+    }
+
+    usage_slots.swap(new_usage_slots);
+    input_state.swap(new_input_state);
+    active_slots.swap(new_active_slots);
+    prev_active_slots.swap(new_prev_active_slots);
+    rising_slots.assign(active_slots.size(), 0);
+    dirty_slots.assign(active_slots.size(), 0);
+    accumulated.swap(new_accumulated);
+    sticky_slots.swap(new_sticky_slots);
+    sticky_state.swap(new_sticky_state);
+
+    // this is how handle_received_report() knows where to put things (and how to read them)
+    interface_plan_count = 0;
+    for (auto const& [interface, report_id_usage_map] : their_usages) {
+        if (interface_plan_count == MAX_INTERFACES) {
+            break;
+        }
+        build_interface_plan(interface_plans[interface_plan_count++], interface, report_id_usage_map, their_arrays[interface]);
+    }
+
+    mouse_x_slot = usage_slots[MOUSE_X_USAGE];
+    mouse_y_slot = usage_slots[MOUSE_Y_USAGE];
+}
+
+map_op_t make_op(uint32_t target, const map_source_t& map_source) {
+    map_op_t op = {
+        .source_slot = usage_slots[map_source.usage],
+        .sticky_slot = NO_SLOT,
+        .scaling = scaling_to_fixed(map_source.scaling),
+        .layer = map_source.layer,
+        .flags = 0,
+    };
+    if (map_source.sticky) {
+        op.flags |= OP_FLAG_STICKY;
+        op.sticky_slot = sticky_slots[sticky_key(target, map_source.usage, map_source.layer)];
+    }
+    if (relative_usage_set.count(map_source.usage)) {
+        op.flags |= OP_FLAG_SOURCE_RELATIVE;
+    }
+    return op;
+}
+
+void compile_mapping_program() {
+    mapping_program.clear();
+    auto_repeat_program.clear();
+    absolute_program.clear();
+    absolute_target_starts.clear();
+    layer_triggers.clear();
+    layer_triggering_stickies.clear();
+    sticky_usages.clear();
+    screen_switching_usages.clear();
+    accumulated_targets.clear();
+    std::unordered_set<uint16_t> accumulated_slot_set;
+    std::unordered_set<uint16_t> layer_triggering_sticky_set;
+    std::unordered_set<uint16_t> sticky_usage_set;
     std::unordered_set<uint64_t> screen_switching_usages_set;
+    scroll_target_slots.clear();
+    std::vector<uint32_t> new_scroll_sources;
+    std::unordered_map<uint32_t, uint16_t> scroll_source_indexes;  // usage -> scroll_index
+
+    for (auto const& [target, sources] : reverse_mapping) {
+        for (auto const& map_source : sources) {
+            map_op_t op = make_op(target, map_source);
+            if (map_source.sticky) {
+                if ((target & 0xFFFF0000) == LAYERS_USAGE_PAGE) {
+                    if (layer_triggering_sticky_set.insert(op.sticky_slot).second) {
+                        layer_triggering_stickies.push_back(op);
+                    }
+                } else {
+                    if (sticky_usage_set.insert(op.sticky_slot).second) {
+                        sticky_usages.push_back(op);
+                    }
+                }
+            }
+            if (target == SWITCH_SCREEN_USAGE) {
+                if (screen_switching_usages_set.insert(((uint64_t) op.layer << 32) | op.source_slot).second) {
+                    screen_switching_usages.push_back(op);
+                }
+            }
+            if ((target & 0xFFFF0000) == LAYERS_USAGE_PAGE) {
+                uint32_t layer = target & 0xFFFF;
+                if ((layer > 0) && (layer < NLAYERS)) {
+                    op.layer = layer;
+                    layer_triggers.push_back(op);
+                }
+            }
+        }
+
+        auto search = our_usages_flat.find(target);
+        if (search == our_usages_flat.end()) {
+            continue;
+        }
+        const usage_def_t& our_usage = search->second;
+        auto mask_search = resolution_multiplier_masks.find(target);
+        for (auto const& map_source : sources) {
+            map_op_t op = make_op(target, map_source);
+            op.target_slot = usage_slots[target];
+            op.bitpos = our_usage.bitpos;
+            op.report_id = our_usage.report_id;
+            op.size = our_usage.size;
+            op.kernel = our_usage.kernel;
+            op.resolution_mask = (mask_search != resolution_multiplier_masks.end()) ? mask_search->second : (uint8_t) 0;
+            if (op.resolution_mask) {
+                auto [it, inserted] = scroll_source_indexes.try_emplace(map_source.usage, new_scroll_sources.size());
+                if (inserted) {
+                    new_scroll_sources.push_back(map_source.usage);
+                }
+                op.scroll_index = it->second;
+            }
+            if (our_usage.is_relative || target == MOUSE_X_USAGE || target == MOUSE_Y_USAGE) {
+                op.flags |= OP_FLAG_ACCUMULATE;
+                if (accumulated_slot_set.insert(op.target_slot).second) {
+                    accumulated_targets.push_back(our_usage);
+                    accumulated_targets.back().slot = op.target_slot;
+                    if (op.resolution_mask) {
+                        scroll_target_slots.push_back(op.target_slot);
+                    }
+                }
+                if ((op.flags & OP_FLAG_SOURCE_RELATIVE) && !(op.flags & OP_FLAG_STICKY)) {
+                    mapping_program.push_back(op);
+                } else {
+                    auto_repeat_program.push_back(op);
+                }
+            } else {
+                if ((absolute_target_starts.empty()) || (absolute_program[absolute_target_starts.back()].target_slot != op.target_slot)) {
+                    absolute_target_starts.push_back(absolute_program.size());
+                }
+                absolute_program.push_back(op);
+            }
+        }
+    }
+    uint16_t ntargets = absolute_target_starts.size();
+    absolute_target_starts.push_back(absolute_program.size());
+
+    // partial scroll carries over for sources that were already there
+    std::vector<int32_t> new_accumulated_scroll(new_scroll_sources.size(), 0);
+    timer_wheel_t new_scroll_timers;
+    new_scroll_timers.now = scroll_timers.now;
+    timer_wheel_reset(new_scroll_timers, new_scroll_sources.size());
+    for (uint16_t j = 0; j < scroll_sources.size(); j++) {
+        auto search = scroll_source_indexes.find(scroll_sources[j]);
+        if (search != scroll_source_indexes.end()) {
+            uint16_t i = search->second;
+            new_accumulated_scroll[i] = accumulated_scroll[j];
+            if (timer_pending(scroll_timers, j)) {
+                timer_schedule(new_scroll_timers, i, timer_remaining(scroll_timers, j));
+            }
+        }
+    }
+    std::swap(scroll_sources, new_scroll_sources);
+    std::swap(accumulated_scroll, new_accumulated_scroll);
+    std::swap(scroll_timers, new_scroll_timers);
+
+    dependents_starts.assign(input_state.size() + 1, 0);
+    for (auto const& op : absolute_program) {
+        dependents_starts[op.source_slot + 1]++;
+    }
+    for (uint16_t slot = 0; slot < input_state.size(); slot++) {
+        dependents_starts[slot + 1] += dependents_starts[slot];
+    }
+    dependents.resize(absolute_program.size());
+    std::vector<uint16_t> fill(dependents_starts.begin(), dependents_starts.end() - 1);
+    for (uint16_t target = 0; target < ntargets; target++) {
+        for (uint16_t i = absolute_target_starts[target]; i < absolute_target_starts[target + 1]; i++) {
+            dependents[fill[absolute_program[i].source_slot]++] = target;
+        }
+    }
+
+    dirty_targets.assign((ntargets + 31) / 32, 0);
+
+    // absolute targets keep their values between ticks now, start from scratch
+    for (auto report_id : report_ids) {
+        memset(reports[report_id], 0, report_sizes[report_id]);
+    }
+    evaluate_all_targets = true;
+
+    relative_slots.clear();
+    for (auto const& usage : relative_usage_set) {
+        relative_slots.push_back(usage_slots[usage]);
+    }
+}
+
+// The descriptor parser holds their_usages_mutex while it parses (and prints)
+// a whole descriptor. Rather than wait for that, this leaves
+// their_descriptor_updated set and the main loop tries again next time around.
+// Until then the old slots, plans and mapping program stay, they still go
+// together.
+void update_their_descriptor_derivates() {
+    if (!mutex_try_enter(&their_usages_mutex, NULL)) {
+        their_descriptor_updated = true;
+        return;
+    }
+    if (!update_their_usage_refs() && !mapping_stale) {
+        // same usages, so same slots and the same mapping program, only the
+        // plans of the interfaces that changed need to be built
+        update_interface_plans();
+        mutex_exit(&their_usages_mutex);
+        return;
+    }
+    intern_usages();
+    mutex_exit(&their_usages_mutex);
+
+    // which sources are relative is baked into the mapping program
+    compile_mapping_program();
+    mapping_stale = false;
+}
+
+void set_mapping_from_config() {
     std::unordered_set<uint32_t> mapped;
 
     reverse_mapping.clear();
@@ -181,22 +871,8 @@ void set_mapping_from_config() {
         if (mapping.layer == 0) {
             mapped.insert(mapping.source_usage);
         }
-        if ((mapping.flags & MAPPING_FLAG_STICKY) != 0) {
-            if ((mapping.target_usage & 0xFFFF0000) == LAYERS_USAGE_PAGE) {
-                layer_triggering_sticky_set.insert(mapping.source_usage);
-            } else {
-                sticky_usage_set.insert(((uint64_t) mapping.layer << 32) | mapping.source_usage);
-            }
-        }
-        if (mapping.target_usage == SWITCH_SCREEN_USAGE) {
-            screen_switching_usages_set.insert(((uint64_t) mapping.layer << 32) | mapping.source_usage);
-        }
     }
 
-    layer_triggering_stickies.assign(layer_triggering_sticky_set.begin(), layer_triggering_sticky_set.end());
-    sticky_usages.assign(sticky_usage_set.begin(), sticky_usage_set.end());
-    screen_switching_usages.assign(screen_switching_usages_set.begin(), screen_switching_usages_set.end());
-
     if (unmapped_passthrough) {
         for (auto const& [usage, usage_def] : our_usages_flat) {
             if (!mapped.count(usage)) {
@@ -204,332 +880,771 @@ void set_mapping_from_config() {
             }
         }
     }
+
+    // slots and the mapping program get rebuilt there, maybe on a later pass of the main loop
+    mapping_stale = true;
+    update_their_descriptor_derivates();
 }
 
-void screens_updated() {
-    bounds_min_x = screens[0].x;
-    bounds_max_x = screens[0].x + screens[0].w;
-    bounds_min_y = screens[0].y;
-    bounds_max_y = screens[0].y + screens[0].h;
-    for (uint8_t i = 1; i < NSCREENS; i++) {
-        bounds_min_x = std::min(bounds_min_x, (int64_t) screens[i].x);
-        bounds_max_x = std::max(bounds_max_x, (int64_t) screens[i].x + screens[i].w);
-        bounds_min_y = std::min(bounds_min_y, (int64_t) screens[i].y);
-        bounds_max_y = std::max(bounds_max_y, (int64_t) screens[i].y + screens[i].h);
+void offscreen_sensitivity_updated() {
+    offscreen_sensitivity = std::min(screens[-1].sensitivity, MAX_SENSITIVITY);
+}
+
+void resolution_multiplier_updated() {
+    for (uint8_t i = 0; i < screen_count; i++) {
+        screen_params_t& params = screen_params[i];
+        if (params.route == ScreenRoute::LOCAL_USB) {
+            params.resolution_multiplier = resolution_multiplier;
+        } else {
+            params.resolution_multiplier = params.hires_forwarder ? FORWARDER_RESOLUTION_MULTIPLIER : 0;
+        }
     }
+}
 
-    cursor_x = screens[0].x + screens[0].w / 2;
-    cursor_y = screens[0].y + screens[0].h / 2;
-    active_screen = 0;
+void report_priority_updated() {
+    std::sort(report_ids.begin(), report_ids.end(), [](uint8_t a, uint8_t b) {
+        return std::make_pair(report_priority[a - 1], a) < std::make_pair(report_priority[b - 1], b);
+    });
 }
 
-bool differ_on_absolute(const uint8_t* report1, const uint8_t* report2, uint8_t report_id) {
-    uint8_t* absolute = report_masks_absolute[report_id];
+void screens_updated() {
+    for (uint8_t i = 0; i < screen_count; i++) {
+        screen_params_t& params = screen_params[i];
+        params.x = std::min(screens[i].x, (uint32_t) INT32_MAX);
+        params.y = std::min(screens[i].y, (uint32_t) INT32_MAX);
+        params.x_end = saturate((int64_t) params.x + screens[i].w);
+        params.y_end = saturate((int64_t) params.y + screens[i].h);
+        params.sensitivity = std::min(screens[i].sensitivity, MAX_SENSITIVITY);
+        params.x_scale = coordinate_scale(screens[i].w);
+        params.y_scale = coordinate_scale(screens[i].h);
+        params.route = screens[i].route;
+        params.forwarder_address = screens[i].forwarder_address;
+        params.hires_forwarder = (screens[i].flags & SCREEN_FLAG_HIRES_FORWARDER) != 0;
+    }
+    offscreen_sensitivity_updated();
+    resolution_multiplier_updated();
+
+    // where screens overlap, the one with the lowest index wins, so the lists
+    // are in index order and the first screen in them that has the point is it
+    for (uint8_t i = 0; i < screen_count; i++) {
+        screen_params_t& from = screen_params[i];
+        from.overlapped = false;
+        for (uint8_t edge = 0; edge < NEDGES; edge++) {
+            screens_across[i][edge].clear();
+        }
+        for (uint8_t j = 0; j < screen_count; j++) {
+            const screen_params_t& to = screen_params[j];
+            if ((i == j) || screen_empty(j)) {
+                continue;
+            }
+            bool x_overlap = (to.x < from.x_end) && (from.x < to.x_end);
+            bool y_overlap = (to.y < from.y_end) && (from.y < to.y_end);
+            if (x_overlap && y_overlap && (j < i)) {
+                from.overlapped = true;
+            }
+            if (y_overlap && (to.x < from.x)) {
+                screens_across[i][EDGE_LEFT].push_back(j);
+            }
+            if (y_overlap && (to.x_end > from.x_end)) {
+                screens_across[i][EDGE_RIGHT].push_back(j);
+            }
+            if (x_overlap && (to.y < from.y)) {
+                screens_across[i][EDGE_TOP].push_back(j);
+            }
+            if (x_overlap && (to.y_end > from.y_end)) {
+                screens_across[i][EDGE_BOTTOM].push_back(j);
+            }
+        }
+    }
 
-    for (int i = 0; i < report_sizes[report_id]; i++) {
-        if ((report1[i] & absolute[i]) != (report2[i] & absolute[i])) {
-            return true;
+    // empty screens don't count, if there are only empty screens there's no box to keep the cursor in
+    bounds_min_x = INT32_MAX;
+    bounds_max_x = INT32_MIN;
+    bounds_min_y = INT32_MAX;
+    bounds_max_y = INT32_MIN;
+    for (uint8_t i = 0; i < screen_count; i++) {
+        if (screen_empty(i)) {
+            continue;
         }
+        bounds_min_x = std::min(bounds_min_x, screen_params[i].x);
+        bounds_max_x = std::max(bounds_max_x, screen_params[i].x_end);
+        bounds_min_y = std::min(bounds_min_y, screen_params[i].y);
+        bounds_max_y = std::max(bounds_max_y, screen_params[i].y_end);
+    }
+    if (bounds_min_x > bounds_max_x) {
+        bounds_min_x = INT32_MIN;
+        bounds_max_x = INT32_MAX;
+        bounds_min_y = INT32_MIN;
+        bounds_max_y = INT32_MAX;
     }
 
-    return false;
+    move_cursor_to_center(0);
 }
 
-void aggregate_relative(uint8_t* prev_report, const uint8_t* report, uint8_t report_id) {
-    for (auto const& [usage, usage_def] : our_usages[report_id]) {
-        if (usage_def.is_relative) {
-            int32_t val1 = get_bits(report, report_sizes[report_id], usage_def.bitpos, usage_def.size);
-            if (usage_def.logical_minimum < 0) {
-                if (val1 & (1 << (usage_def.size - 1))) {
-                    val1 |= 0xFFFFFFFF << usage_def.size;
-                }
+inline int32_t get_relative(const uint8_t* report, uint8_t report_id, const usage_def_t& usage_def) {
+    int32_t value = get_bits(report, report_sizes[report_id], usage_def.bitpos, usage_def.size, usage_def.kernel);
+    if (usage_def.logical_minimum < 0) {
+        if (value & (1 << (usage_def.size - 1))) {
+            value |= 0xFFFFFFFF << usage_def.size;
+        }
+    }
+    return value;
+}
+
+// Adds the relative fields of report to prev_report. Returns false (and leaves
+// prev_report alone) if a sum wouldn't fit in its field.
+bool aggregate_relative(uint8_t* prev_report, const uint8_t* report, uint8_t report_id) {
+    for (auto const& [usage, usage_def] : OUR_LAYOUT.relative_usages) {
+        if (usage_def.report_id == report_id) {
+            int64_t sum = (int64_t) get_relative(prev_report, report_id, usage_def) + get_relative(report, report_id, usage_def);
+            int64_t min = (usage_def.logical_minimum < 0) ? -(1ll << (usage_def.size - 1)) : 0;
+            int64_t max = (usage_def.logical_minimum < 0) ? (1ll << (usage_def.size - 1)) - 1 : (1ll << usage_def.size) - 1;
+            if ((sum < min) || (sum > max)) {
+                return false;
             }
+        }
+    }
+    for (auto const& [usage, usage_def] : OUR_LAYOUT.relative_usages) {
+        if (usage_def.report_id == report_id) {
+            int32_t val1 = get_relative(report, report_id, usage_def);
             if (val1) {
-                int32_t val2 = get_bits(prev_report, report_sizes[report_id], usage_def.bitpos, usage_def.size);
-                if (usage_def.logical_minimum < 0) {
-                    if (val2 & (1 << (usage_def.size - 1))) {
-                        val2 |= 0xFFFFFFFF << usage_def.size;
-                    }
-                }
+                int32_t val2 = get_relative(prev_report, report_id, usage_def);
+                put_bits(prev_report, report_sizes[report_id], usage_def.bitpos, usage_def.size, val1 + val2, usage_def.kernel);
+            }
+        }
+    }
+    return true;
+}
 
-                put_bits(prev_report, report_sizes[report_id], usage_def.bitpos, usage_def.size, val1 + val2);
+inline bool inside_screen(uint8_t screen, int32_t x, int32_t y) {
+    const screen_params_t& params = screen_params[screen];
+    return (params.x <= x) && (x < params.x_end) && (params.y <= y) && (y < params.y_end);
+}
+
+// Which screen (x, y) is on, starting from the one the cursor is on now. Where
+// screens overlap, it's the one with the lowest index.
+int8_t find_screen(int32_t x, int32_t y) {
+    if (active_screen != -1) {
+        const screen_params_t& params = screen_params[active_screen];
+        bool x_inside = (params.x <= x) && (x < params.x_end);
+        bool y_inside = (params.y <= y) && (y < params.y_end);
+        if (x_inside && y_inside) {
+            if (!params.overlapped) {
+                return active_screen;
             }
+        } else if (x_inside || y_inside) {
+            uint8_t edge = !x_inside ? ((x < params.x) ? EDGE_LEFT : EDGE_RIGHT)
+                                     : ((y < params.y) ? EDGE_TOP : EDGE_BOTTOM);
+            for (auto screen : screens_across[active_screen][edge]) {
+                if (inside_screen(screen, x, y)) {
+                    return screen;
+                }
+            }
+            return -1;
+        }
+    }
+    // went out through a corner, we're where screens overlap or we weren't on any screen to begin with
+    for (uint8_t i = 0; i < screen_count; i++) {
+        if (inside_screen(i, x, y)) {
+            return i;
         }
     }
+    return -1;
 }
 
-bool within_bounds(int64_t x, int64_t y, int8_t& active_screen) {
-    active_screen = -1;
-    for (uint8_t i = 0; i < NSCREENS; i++) {
-        if (screens[i].x <= x &&
-            x < screens[i].x + screens[i].w &&
-            screens[i].y <= y &&
-            y < screens[i].y + screens[i].h) {
-            active_screen = i;
-            break;
+// Moves the cursor to (x, y) or, if the constraint mode doesn't allow that,
+// as close to it as it can go, so that it slides along screen edges.
+void move_cursor(int32_t x, int32_t y) {
+    if (constraint_mode == ConstraintMode::BOUNDING_BOX) {
+        x = std::clamp(x, bounds_min_x, bounds_max_x - 1);
+        y = std::clamp(y, bounds_min_y, bounds_max_y - 1);
+    }
+
+    int8_t target_screen = find_screen(x, y);
+    if ((target_screen != -1) || (constraint_mode != ConstraintMode::VISIBLE)) {
+        cursor_x = x;
+        cursor_y = y;
+        active_screen = target_screen;
+        return;
+    }
+
+    // only consider screens that moving along one axis would have kept us on or taken us to
+    int8_t candidates[] = { active_screen, find_screen(x, cursor_y), find_screen(cursor_x, y) };
+    int8_t nearest_screen = -1;
+    int32_t nearest_x = x;
+    int32_t nearest_y = y;
+    uint64_t nearest_distance = UINT64_MAX;
+    for (auto screen : candidates) {
+        if ((screen == -1) || screen_empty(screen)) {
+            continue;
+        }
+        const screen_params_t& params = screen_params[screen];
+        int32_t clamped_x = std::clamp(x, params.x, params.x_end - 1);
+        int32_t clamped_y = std::clamp(y, params.y, params.y_end - 1);
+        uint64_t distance = (uint64_t) std::abs((int64_t) x - clamped_x) + std::abs((int64_t) y - clamped_y);
+        if (distance < nearest_distance) {
+            nearest_distance = distance;
+            nearest_screen = screen;
+            nearest_x = clamped_x;
+            nearest_y = clamped_y;
         }
     }
 
-    return ((constraint_mode == ConstraintMode::VISIBLE && active_screen != -1) ||
-            (constraint_mode == ConstraintMode::BOUNDING_BOX &&
-                x >= bounds_min_x &&
-                x < bounds_max_x &&
-                y >= bounds_min_y &&
-                y < bounds_max_y) ||
-            (constraint_mode == ConstraintMode::NO_CONSTRAINT));
+    if (nearest_screen != -1) {
+        cursor_x = nearest_x;
+        cursor_y = nearest_y;
+        active_screen = nearest_screen;
+    }
 }
 
-void process_mapping(bool auto_repeat) {
-    if (suspended) {
-        return;
+inline void accumulate(const map_op_t& op, int32_t value) {
+    if (value != 0) {
+        if (op.resolution_mask) {
+            accumulated[op.target_slot] = add_saturating(accumulated[op.target_slot], handle_scroll(op, value));
+        } else {
+            accumulated[op.target_slot] = add_saturating(accumulated[op.target_slot], value);
+        }
     }
+}
 
-    for (auto const& usage : layer_triggering_stickies) {
-        if ((prev_input_state[usage] == 0) && (input_state[usage] != 0)) {
-            sticky_state[usage] = !sticky_state[usage];
+void evaluate_absolute_target(uint16_t target) {
+    int32_t value = 0;
+    // the value for absolute targets is always 1 so sources are effectively OR-ed together
+    for (uint16_t i = absolute_target_starts[target]; i < absolute_target_starts[target + 1]; i++) {
+        const map_op_t& op = absolute_program[i];
+        if (((op.flags & OP_FLAG_STICKY) && bitset_test(sticky_state, op.sticky_slot)) ||
+            ((layer_mask & (1 << op.layer)) &&
+                ((op.flags & OP_FLAG_SOURCE_RELATIVE)
+                        ? (mul_saturating(input_state[op.source_slot], op.scaling) > 0)
+                        : input_state[op.source_slot]))) {
+            value = 1;
+            break;
         }
-        prev_input_state[usage] = input_state[usage];
     }
+    const map_op_t& op = absolute_program[absolute_target_starts[target]];
+    put_bits((uint8_t*) reports[op.report_id], report_sizes[op.report_id], op.bitpos, op.size, value, op.kernel);
+}
 
-    static bool layer_state[NLAYERS];
-    // layer triggers work on all layers (no matter what layer they are defined on)
-    // they can be sticky
-    layer_state[0] = true;
-    for (int i = 1; i < NLAYERS; i++) {
-        layer_state[i] = false;
-        for (auto const& map_source : reverse_mapping[LAYERS_USAGE_PAGE | i]) {
-            if (map_source.sticky ? sticky_state[map_source.usage] : input_state[map_source.usage]) {
-                layer_state[i] = true;
-                layer_state[0] = false;
-                break;
+// Moves whole units from the accumulators of relative targets into reports.
+void write_accumulated() {
+    for (auto const& our_usage : accumulated_targets) {
+        int32_t& accumulated_val = accumulated[our_usage.slot];
+        if (accumulated_val == 0) {
+            continue;
+        }
+        int32_t existing_val = get_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size, our_usage.kernel);
+        if (our_usage.logical_minimum < 0) {
+            if (existing_val & (1 << (our_usage.size - 1))) {
+                existing_val |= 0xFFFFFFFF << our_usage.size;
             }
         }
+        int32_t truncated = accumulated_val / FIXED_ONE;
+        accumulated_val -= truncated * FIXED_ONE;
+        if (truncated != 0) {
+            put_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size, existing_val + truncated, our_usage.kernel);
+        }
     }
+}
 
-    for (auto const& layer_usage : sticky_usages) {
-        uint32_t usage = layer_usage & 0xFFFFFFFF;
-        uint32_t layer = layer_usage >> 32;
-        if (layer_state[layer]) {
-            if ((prev_input_state[usage] == 0) && (input_state[usage] != 0)) {
-                sticky_state[layer_usage] = !sticky_state[layer_usage];
-            }
+// Newest report in the queue for the active screen with the given report ID, -1 if there isn't one.
+int8_t newest_queued(const outgoing_queue_t& queue, uint8_t report_id) {
+    for (uint8_t j = queue.items; j > 0; j--) {
+        uint8_t idx = (queue.head + j - 1) % queue.size;
+        const uint8_t* slot = (const uint8_t*) queue.reports[idx];
+        if ((slot[SLOT_SCREEN] == active_screen) && (slot[SLOT_REPORT_ID] == report_id)) {
+            return idx;
         }
-        prev_input_state[usage] = input_state[usage];
     }
+    return -1;
+}
 
-    for (auto const& layer_usage : screen_switching_usages) {
-        uint32_t usage = layer_usage & 0xFFFFFFFF;
-        uint32_t layer = layer_usage >> 32;
-        if (layer_state[layer]) {
-            if ((prev_input_state[usage] == 0) && (input_state[usage] != 0)) {
-                active_screen = (active_screen + 1) % NSCREENS;
-                cursor_x = screens[active_screen].x + screens[active_screen].w / 2;
-                cursor_y = screens[active_screen].y + screens[active_screen].h / 2;
-            }
+// Merges report into a queued one: relative fields add up, absolute fields are replaced.
+// Edge bits can only change if the queued report didn't already change them (in
+// changes), otherwise the host would never see one of the transitions.
+bool merge_into(outgoing_queue_t& queue, int8_t idx, const uint32_t* report, uint8_t report_id, const uint32_t* changes) {
+    uint32_t* queued_report = slot_report(queue.reports[idx]);
+    const uint32_t* absolute = report_masks_absolute[report_id];
+    const uint32_t* edge = report_masks_edge[report_id];
+    for (int k = 0; k < report_words[report_id]; k++) {
+        if ((report[k] ^ queued_report[k]) & edge[k] & changes[k]) {
+            return false;
         }
-        prev_input_state[usage] = input_state[usage];
     }
+    if (!aggregate_relative((uint8_t*) queued_report, (const uint8_t*) report, report_id)) {
+        return false;
+    }
+    for (int k = 0; k < report_words[report_id]; k++) {
+        queue.changes[idx][k] |= (report[k] ^ queued_report[k]) & edge[k];
+        queued_report[k] = (queued_report[k] & ~absolute[k]) | (report[k] & absolute[k]);
+    }
+    prev_reports[report_id] = queued_report;
+    queue.merged++;
+    return true;
+}
 
-    for (auto const& [target, sources] : reverse_mapping) {
-        auto search = our_usages_flat.find(target);
-        if (search == our_usages_flat.end()) {
-            continue;
+// Reports that change buttons or keys each get their own slot. Only when the
+// queue is full do they get merged into the one before them, and only if that's
+// the last one in the queue, otherwise they would overtake the reports in between.
+bool queue_edge(uint8_t report_id, const uint32_t* report) {
+    if (edge_queue.items == edge_queue.size) {
+        uint8_t idx = (edge_queue.tail + edge_queue.size - 1) % edge_queue.size;
+        const uint8_t* slot = (const uint8_t*) edge_queue.reports[idx];
+        return (slot[SLOT_SCREEN] == active_screen) && (slot[SLOT_REPORT_ID] == report_id) &&
+               merge_into(edge_queue, idx, report, report_id, edge_queue.changes[idx]);
+    }
+    uint8_t idx = edge_queue.tail;
+    uint32_t* slot = reserve(edge_queue, active_screen, report_id);
+    const uint32_t* prev_report = prev_reports[report_id];
+    const uint32_t* edge = report_masks_edge[report_id];
+    for (int k = 0; k < report_words[report_id]; k++) {
+        edge_queue.changes[idx][k] = (report[k] ^ prev_report[k]) & edge[k];
+    }
+    memcpy(slot, report, report_words[report_id] * 4);
+    commit(edge_queue);
+    return true;
+}
+
+// Motion goes into the newest queued report for the same screen and report ID if
+// there is one. No edge bits can change there, motion reports don't change any.
+bool queue_motion(uint8_t report_id) {
+    int8_t idx = newest_queued(motion_queue, report_id);
+    if ((idx != -1) && merge_into(motion_queue, idx, reports[report_id], report_id, report_masks_edge[report_id])) {
+        return true;
+    }
+    if (motion_queue.items == motion_queue.size) {
+        return false;
+    }
+    memcpy(reserve(motion_queue, active_screen, report_id), reports[report_id], report_words[report_id] * 4);
+    commit(motion_queue);
+    return true;
+}
+
+// Returns false if the report has to wait because the queue is full. It then
+// stays in reports and goes out when there's room. If it changes buttons or keys
+// and the next input takes that back first, the host never sees the transition,
+// so those are counted as dropped.
+bool queue_report(uint8_t report_id, bool include_motion) {
+    uint32_t* report = reports[report_id];
+
+    if (!needs_to_be_sent(report_id)) {
+        return true;
+    }
+    if (is_edge(report_id)) {
+        if (!queue_edge(report_id, report)) {
+            edge_queue.dropped++;
+            return false;
         }
-        const usage_def_t& our_usage = search->second;
-        if (our_usage.is_relative || target == MOUSE_X_USAGE || target == MOUSE_Y_USAGE) {
-            for (auto const& map_source : sources) {
-                bool source_is_relative = relative_usage_set.count(map_source.usage);
-                if (auto_repeat || source_is_relative) {
-                    int32_t value = 0;
-                    if (map_source.sticky) {
-                        value = sticky_state[((uint64_t) map_source.layer << 32) | map_source.usage] * map_source.scaling;
-                    } else {
-                        if (layer_state[map_source.layer]) {
-                            value = (source_is_relative
-                                            ? input_state[map_source.usage]
-                                            : !!input_state[map_source.usage]) *
-                                    map_source.scaling;
-                        }
-                    }
-                    if (value != 0) {
-                        if (target == V_SCROLL_USAGE || target == H_SCROLL_USAGE) {
-                            accumulated[target] += handle_scroll(map_source.usage, target, value * RESOLUTION_MULTIPLIER);
-                        } else {
-                            accumulated[target] += value;
-                        }
-                    }
+        // motion still waiting in the other queue will go out after this, so it must
+        // not take buttons (or the cursor) back to where they were
+        const uint32_t* absolute = report_masks_absolute[report_id];
+        for (uint8_t j = 0; j < motion_queue.items; j++) {
+            uint32_t* queued = motion_queue.reports[(motion_queue.head + j) % motion_queue.size];
+            if ((((uint8_t*) queued)[SLOT_SCREEN] == active_screen) && (((uint8_t*) queued)[SLOT_REPORT_ID] == report_id)) {
+                uint32_t* queued_report = slot_report(queued);
+                for (int k = 0; k < report_words[report_id]; k++) {
+                    queued_report[k] = (queued_report[k] & ~absolute[k]) | (report[k] & absolute[k]);
                 }
             }
-        } else {
-            int32_t value = 0;
-            for (auto const& map_source : sources) {
-                if (map_source.sticky && (sticky_state[((uint64_t) map_source.layer << 32) | map_source.usage] != 0)) {
-                    value = sticky_state[((uint64_t) map_source.layer << 32) | map_source.usage];
-                } else {
-                    if ((layer_state[map_source.layer]) &&
-                        (relative_usage_set.count(map_source.usage)
-                                ? (input_state[map_source.usage] * map_source.scaling > 0)
-                                : input_state[map_source.usage])) {
-                        value = 1;
-                    }
-                }
+        }
+    } else if (include_motion) {
+        if (!queue_motion(report_id)) {
+            motion_queue.deferred++;
+            return false;
+        }
+    }
+    return true;
+}
+
+// With include_motion false only reports that change buttons or keys are queued,
+// the rest stays in reports (and the accumulators) until send_report() wants it.
+void queue_reports(bool include_motion) {
+    // Reports are queued in priority order and the queues go out in order, so with
+    // the keyboard first a modifier never arrives later than the click it goes with.
+    // We stop at the first one that doesn't fit for the same reason. What didn't
+    // make it stays in reports, send_report() tries again when there's room.
+    bool full = false;
+    for (uint i = 0; i < report_ids.size(); i++) {
+        uint8_t report_id = report_ids[i];
+        if (active_screen != -1) {
+            if (!full) {
+                full = !queue_report(report_id, include_motion);
             }
-            if (value) {
-                put_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size, value);
+            if (full) {
+                continue;
             }
         }
+        // absolute targets are only updated when something changes so we keep them around
+        for (int j = 0; j < report_words[report_id]; j++) {
+            reports[report_id][j] &= ~report_masks_relative[report_id][j];
+        }
     }
+    reports_waiting = full;
+}
 
-    for (auto usage : relative_usages) {
-        input_state[usage] = 0;
+// With late-bound motion the screen we're leaving might not have been sent the
+// last cursor position we had for it yet.
+void flush_cursor(int8_t screen) {
+    uint8_t report_id = OUR_MOUSE_X.def.report_id;
+    uint32_t* report = reports[report_id];
+    uint32_t* prev_report = prev_reports[report_id];
+    const uint32_t* absolute = report_masks_absolute[report_id];
+    const uint32_t* edge = report_masks_edge[report_id];
+
+    bool moved = false;
+    for (int i = 0; i < report_words[report_id]; i++) {
+        moved |= ((report[i] ^ prev_report[i]) & absolute[i] & ~edge[i]) != 0;
     }
+    if (!moved || (motion_queue.items == motion_queue.size)) {
+        return;
+    }
+    uint32_t* slot = reserve(motion_queue, screen, report_id);
+    prev_report = prev_reports[report_id];  // might have moved out of the slot
+    // buttons and keys stay as they were last sent, they go out with the new screen's reports
+    for (int i = 0; i < report_words[report_id]; i++) {
+        uint32_t cursor = absolute[i] & ~edge[i];
+        slot[i] = (prev_report[i] & ~cursor) | (report[i] & cursor);
+    }
+    commit(motion_queue);
+}
 
-    int64_t dx = (int64_t) accumulated[MOUSE_X_USAGE] * screens[active_screen].sensitivity / 1000;
-    int64_t new_cursor_x = cursor_x + dx;
-    int64_t dy = (int64_t) accumulated[MOUSE_Y_USAGE] * screens[active_screen].sensitivity / 1000;
-    int64_t new_cursor_y = cursor_y + dy;
-    accumulated[MOUSE_X_USAGE] -= dx;
-    accumulated[MOUSE_Y_USAGE] -= dy;
+void process_mapping(bool auto_repeat) {
+    int8_t prev_screen = active_screen;
 
-    int8_t new_active_screen;
-    if (within_bounds(new_cursor_x, new_cursor_y, new_active_screen)) {
-        cursor_x = new_cursor_x;
-        cursor_y = new_cursor_y;
-        active_screen = new_active_screen;
-    } else if (within_bounds(cursor_x, new_cursor_y, new_active_screen)) {  // so that the cursor doesn't snag on screen edges
-        cursor_y = new_cursor_y;
-        active_screen = new_active_screen;
-    } else if (within_bounds(new_cursor_x, cursor_y, new_active_screen)) {
-        cursor_x = new_cursor_x;
-        active_screen = new_active_screen;
+    bool any_rising = false;
+    for (uint16_t word = 0; word < active_slots.size(); word++) {
+        rising_slots[word] = active_slots[word] & ~prev_active_slots[word];
+        prev_active_slots[word] = active_slots[word];
+        any_rising |= (rising_slots[word] != 0);
     }
 
-    if (active_screen != -1) {
-        int64_t local_x = (cursor_x - screens[active_screen].x) * 32768 / screens[active_screen].w;
-        int64_t local_y = (cursor_y - screens[active_screen].y) * 32768 / screens[active_screen].h;
+    if (any_rising) {
+        for (auto const& op : layer_triggering_stickies) {
+            if (bitset_test(rising_slots, op.source_slot)) {
+                bitset_toggle(sticky_state, op.sticky_slot);
+                evaluate_all_targets = true;
+            }
+        }
+    }
+
+    // layer triggers work on all layers (no matter what layer they are defined on)
+    // they can be sticky
+    uint32_t new_layer_mask = 0;
+    for (auto const& op : layer_triggers) {
+        if ((op.flags & OP_FLAG_STICKY) ? bitset_test(sticky_state, op.sticky_slot) : bitset_test(active_slots, op.source_slot)) {
+            new_layer_mask |= 1 << op.layer;
+        }
+    }
+    if (new_layer_mask == 0) {
+        new_layer_mask = 1;  // layer 0 is only active when no other layer is
+    }
+    if (new_layer_mask != layer_mask) {
+        layer_mask = new_layer_mask;
+        evaluate_all_targets = true;
+    }
 
-        {
-            usage_def_t& our_usage = our_usages_flat[MOUSE_X_USAGE];
-            put_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size, local_x);
+    if (any_rising) {
+        for (auto const& op : sticky_usages) {
+            if ((layer_mask & (1 << op.layer)) && bitset_test(rising_slots, op.source_slot)) {
+                bitset_toggle(sticky_state, op.sticky_slot);
+                evaluate_all_targets = true;
+            }
         }
-        {
-            usage_def_t& our_usage = our_usages_flat[MOUSE_Y_USAGE];
-            put_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size, local_y);
+
+        for (auto const& op : screen_switching_usages) {
+            if ((layer_mask & (1 << op.layer)) && bitset_test(rising_slots, op.source_slot)) {
+                move_cursor_to_center((active_screen + 1) % screen_count);
+            }
         }
     }
 
-    for (auto& [usage, accumulated_val] : accumulated) {
-        if (accumulated_val == 0) {
-            continue;
+    for (auto const& op : mapping_program) {
+        if (bitset_test(dirty_slots, op.source_slot) && (layer_mask & (1 << op.layer))) {
+            accumulate(op, mul_saturating(input_state[op.source_slot], op.scaling));
         }
-        usage_def_t& our_usage = our_usages_flat[usage];
-        int32_t existing_val = get_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size);
-        if (our_usage.logical_minimum < 0) {
-            if (existing_val & (1 << (our_usage.size - 1))) {
-                existing_val |= 0xFFFFFFFF << our_usage.size;
+    }
+
+    if (auto_repeat) {
+        timer_advance(scroll_timers, [](uint16_t scroll_index) {
+            accumulated_scroll[scroll_index] = 0;
+        });
+
+        for (auto const& op : auto_repeat_program) {
+            int32_t value = 0;
+            if (op.flags & OP_FLAG_STICKY) {
+                value = bitset_test(sticky_state, op.sticky_slot) * op.scaling;
+            } else {
+                if (layer_mask & (1 << op.layer)) {
+                    value = (op.flags & OP_FLAG_SOURCE_RELATIVE)
+                                ? mul_saturating(input_state[op.source_slot], op.scaling)
+                                : !!input_state[op.source_slot] * op.scaling;
+                }
             }
+            accumulate(op, value);
         }
-        int32_t truncated = accumulated_val / 1000;
-        accumulated_val -= truncated * 1000;
-        if (truncated != 0) {
-            put_bits((uint8_t*) reports[our_usage.report_id], report_sizes[our_usage.report_id], our_usage.bitpos, our_usage.size, existing_val + truncated);
+    } else {
+        // sticky ops with relative sources (that's weird, but possible) run every time
+        for (auto const& op : auto_repeat_program) {
+            if ((op.flags & OP_FLAG_STICKY) && (op.flags & OP_FLAG_SOURCE_RELATIVE)) {
+                accumulate(op, bitset_test(sticky_state, op.sticky_slot) * op.scaling);
+            }
         }
     }
 
-    for (uint i = 0; i < report_ids.size(); i++) {  // XXX what order should we go in? maybe keyboard first so that mappings to ctrl-left click work as expected?
-        uint8_t report_id = report_ids[i];
-        if ((active_screen != -1) && needs_to_be_sent(report_id)) {
-            if (or_items == OR_BUFSIZE) {
-                printf("overflow!\n");
-                break;
+    uint16_t ntargets = absolute_target_starts.size() - 1;
+    if (evaluate_all_targets) {
+        for (uint16_t target = 0; target < ntargets; target++) {
+            evaluate_absolute_target(target);
+        }
+        evaluate_all_targets = false;
+    } else {
+        for (uint16_t word = 0; word < dirty_slots.size(); word++) {
+            uint32_t bits = dirty_slots[word];
+            while (bits) {
+                uint16_t slot = word * 32 + __builtin_ctz(bits);
+                bits &= bits - 1;
+                for (uint16_t i = dependents_starts[slot]; i < dependents_starts[slot + 1]; i++) {
+                    dirty_targets[dependents[i] / 32] |= 1 << (dependents[i] % 32);
+                }
             }
-            uint8_t prev = (or_tail + OR_BUFSIZE - 1) % OR_BUFSIZE;
-            if ((or_items > 0) &&
-                (outgoing_reports[prev][0] == active_screen) &&
-                (outgoing_reports[prev][1] == report_id) &&
-                !differ_on_absolute(outgoing_reports[prev] + 2, reports[report_id], report_id)) {
-                aggregate_relative(outgoing_reports[prev] + 2, reports[report_id], report_id);
-            } else {
-                outgoing_reports[or_tail][0] = active_screen;
-                outgoing_reports[or_tail][1] = report_id;
-                memcpy(outgoing_reports[or_tail] + 2, reports[report_id], report_sizes[report_id]);
-                memcpy(prev_reports[report_id], reports[report_id], report_sizes[report_id]);
-                or_tail = (or_tail + 1) % OR_BUFSIZE;
-                or_items++;
+        }
+        for (uint16_t word = 0; word < dirty_targets.size(); word++) {
+            uint32_t bits = dirty_targets[word];
+            while (bits) {
+                evaluate_absolute_target(word * 32 + __builtin_ctz(bits));
+                bits &= bits - 1;
             }
+            dirty_targets[word] = 0;
         }
-        memset(reports[report_id], 0, report_sizes[report_id]);
     }
+
+    memset(dirty_slots.data(), 0, dirty_slots.size() * sizeof(dirty_slots[0]));
+
+    for (auto slot : relative_slots) {
+        if (input_state[slot] != 0) {
+            input_state[slot] = 0;
+            bitset_set(dirty_slots, slot);
+            bitset_set(active_slots, slot, false);
+        }
+    }
+
+    uint32_t sensitivity = (active_screen == -1) ? offscreen_sensitivity : screen_params[active_screen].sensitivity;
+    int32_t new_cursor_x = add_saturating(cursor_x, scale_movement(accumulated[mouse_x_slot], sensitivity));
+    int32_t new_cursor_y = add_saturating(cursor_y, scale_movement(accumulated[mouse_y_slot], sensitivity));
+    // the cursor takes all of the accumulated movement
+    accumulated[mouse_x_slot] = 0;
+    accumulated[mouse_y_slot] = 0;
+
+    move_cursor(new_cursor_x, new_cursor_y);
+
+    // scroll accumulated for a screen with a different resolution multiplier
+    // would come out off by a factor of RESOLUTION_MULTIPLIER
+    if ((active_screen != prev_screen) &&
+        (screen_resolution_multiplier(active_screen) != screen_resolution_multiplier(prev_screen))) {
+        for (auto slot : scroll_target_slots) {
+            accumulated[slot] = 0;
+        }
+    }
+
+    if (late_motion && (active_screen != prev_screen) && (prev_screen != -1)) {
+        flush_cursor(prev_screen);
+    }
+
+    if (active_screen != -1) {
+        const screen_params_t& params = screen_params[active_screen];
+        uint32_t local_x = local_coordinate(cursor_x - params.x, params.x_scale);
+        uint32_t local_y = local_coordinate(cursor_y - params.y, params.y_scale);
+
+        for (auto const& [cursor, value] : { std::pair(OUR_MOUSE_X.def, local_x), std::pair(OUR_MOUSE_Y.def, local_y) }) {
+            put_bits((uint8_t*) reports[cursor.report_id], report_sizes[cursor.report_id], cursor.bitpos, cursor.size, value, cursor.kernel);
+        }
+    }
+
+    if (!late_motion || (active_screen == -1)) {
+        write_accumulated();
+    }
+
+    queue_reports(!late_motion);
 }
 
 void send_report() {
-    if (suspended || (or_items == 0)) {
+    if (late_motion && (edge_queue.items == 0) && (motion_queue.items == 0) && (active_screen != -1)) {
+        // the endpoint is ready, so this is as late as motion can be turned into a report
+        write_accumulated();
+        queue_reports(true);
+    }
+
+    outgoing_queue_t& queue = (edge_queue.items > 0) ? edge_queue : motion_queue;
+    if (queue.items == 0) {
         return;
     }
 
-    uint8_t target_screen = outgoing_reports[or_head][0];
-    uint8_t report_id = outgoing_reports[or_head][1];
+    uint8_t* slot = (uint8_t*) queue.reports[queue.head];
+    uint8_t report_id = slot[SLOT_REPORT_ID];
 
-    if (target_screen == 0) {
-        tud_hid_report(report_id, outgoing_reports[or_head] + 2, report_sizes[report_id]);
+    const screen_params_t& params = screen_params[slot[SLOT_SCREEN]];
+    if (params.route == ScreenRoute::LOCAL_USB) {
+        tud_hid_report(report_id, slot + SLOT_REPORT, report_sizes[report_id]);
     } else {
-        serial_write(outgoing_reports[or_head] + 1, report_sizes[report_id] + 1, FORWARDER_UART);
+        // headers go in front of the report ID, innermost first
+        uint8_t* frame = slot + SLOT_REPORT_ID;
+        if (params.hires_forwarder && ((report_id == SCROLL_REPORT_IDS[0]) || (report_id == SCROLL_REPORT_IDS[1]))) {
+            // the forwarder turns hi-res scroll into clicks if its host wants that
+            uint32_t timeout_ms = std::min((partial_scroll_timeout + 999) / 1000, (uint32_t) 0xFFFF);
+            frame -= 3;
+            frame[0] = FORWARDER_HIRES_MARKER;
+            frame[1] = timeout_ms & 0xFF;
+            frame[2] = timeout_ms >> 8;
+        }
+        if (params.forwarder_address != 0) {
+            // further down the chain, each forwarder decrements the address and passes it on
+            frame -= 2;
+            frame[0] = FORWARDER_CHAIN_MARKER;
+            frame[1] = params.forwarder_address;
+        }
+        serial_write(frame, slot + SLOT_REPORT - frame + report_sizes[report_id], FORWARDER_UART);
     }
 
-    or_head = (or_head + 1) % OR_BUFSIZE;
-    or_items--;
+    uint32_t latency = time_us_32() - queue.enqueued_at[queue.head];
+    queue.sent++;
+    queue.latency_sum += latency;
+    queue.latency_max = std::max(queue.latency_max, latency);
+    report_sent[report_id]++;
+    report_latency_sum[report_id] += latency;
+    report_latency_max[report_id] = std::max(report_latency_max[report_id], latency);
+
+    queue.head = (queue.head + 1) % queue.size;
+    queue.items--;
 
     reports_sent++;
+
+    if (reports_waiting) {
+        // there's room now
+        queue_reports(!late_motion);
+    }
 }
 
-inline void read_input(const uint8_t* report, int len, uint32_t source_usage, const usage_def_t& their_usage, uint16_t interface) {
-    int32_t value = 0;
-    if (their_usage.is_array) {
-        for (uint i = 0; i < their_usage.count; i++) {
-            if (get_bits(report, len, their_usage.bitpos + i * their_usage.size, their_usage.size) == their_usage.index) {
-                value = 1;
-                break;
-            }
-        }
+inline void set_input(uint16_t slot, int32_t value, bool relative, uint32_t index_mask) {
+    int32_t prev_value = input_state[slot];
+    if (relative) {
+        input_state[slot] = value;
     } else {
-        value = get_bits(report, len, their_usage.bitpos, their_usage.size);
-        if (their_usage.logical_minimum < 0) {
-            if (value & (1 << (their_usage.size - 1))) {
-                value |= 0xFFFFFFFF << their_usage.size;
+        if (value) {
+            input_state[slot] |= index_mask;
+        } else {
+            input_state[slot] &= ~index_mask;
+        }
+    }
+    if (input_state[slot] != prev_value) {
+        bitset_set(dirty_slots, slot);
+        bitset_set(active_slots, slot, input_state[slot] != 0);
+    }
+}
+
+inline void read_input(const uint8_t* report, int len, const extract_op_t& op, uint32_t index_mask) {
+    int32_t value = get_bits(report, len, op.bitpos, op.size, op.kernel);
+    if (op.flags & EXTRACT_FLAG_SIGNED) {
+        if (value & (1 << (op.size - 1))) {
+            value |= 0xFFFFFFFF << op.size;
+        }
+    }
+    set_input(op.slot, value, op.flags & EXTRACT_FLAG_RELATIVE, index_mask);
+}
+
+void read_array_input(const uint8_t* report, int len, array_extract_op_t& op, interface_plan_t& plan) {
+    uint32_t nwords = (op.nvalues + 31) / 32;
+    uint32_t* present = array_scratch.data();
+    memset(present, 0, nwords * sizeof(present[0]));
+    for (uint32_t i = 0; i < op.count; i++) {
+        uint32_t value = get_bits(report, len, op.bitpos + i * op.size, op.size, op.kernel) - op.first_value;
+        if (value < op.nvalues) {
+            present[value / 32] |= 1 << (value % 32);
+        }
+    }
+
+    uint32_t* prev_present = plan.array_presence.data() + op.presence_start;
+    const uint16_t* slots = plan.array_slots.data() + op.slots_start;
+    bool update_all = (op.flags & EXTRACT_FLAG_UPDATE_ALL) || !(op.flags & EXTRACT_FLAG_PRIMED);
+    for (uint32_t word = 0; word < nwords; word++) {
+        uint32_t changed = update_all ? 0xFFFFFFFF : present[word] ^ prev_present[word];
+        while (changed) {
+            uint8_t bit = __builtin_ctz(changed);
+            changed &= changed - 1;
+            uint16_t slot = slots[word * 32 + bit];
+            if (slot != NO_SLOT) {
+                set_input(slot, (present[word] >> bit) & 1, op.flags & EXTRACT_FLAG_RELATIVE, plan.index_mask);
             }
         }
+        prev_present[word] = present[word];
     }
+    op.flags |= EXTRACT_FLAG_PRIMED;
+}
 
-    if (their_usage.is_relative) {
-        input_state[source_usage] = value;
-    } else {
-        if (value) {
-            input_state[source_usage] |= 1 << interface_index[interface];
-        } else {
-            input_state[source_usage] &= ~(1 << interface_index[interface]);
+// Same as the last report with this report ID and doesn't have any movement.
+// Decoding it again wouldn't change anything, unless another report ID of the
+// same interface changed some of the same usages in the meantime.
+bool is_duplicate(const interface_plan_t& plan, const raw_report_cache_t& raw_report, uint8_t report_id, const uint8_t* report, int len) {
+    if (!raw_report.cacheable || raw_report.report.empty() || (raw_report.report.size() != (size_t) len)) {
+        return false;
+    }
+    if (plan.shared_slots && (plan.last_report_id != report_id)) {
+        return false;
+    }
+    if (memcmp(raw_report.report.data(), report, len)) {
+        return false;
+    }
+    for (uint i = 0; i < raw_report.relative_mask.size() && i < (uint) len; i++) {
+        if (report[i] & raw_report.relative_mask[i]) {
+            return false;
         }
     }
+    return true;
 }
 
-void handle_received_report(const uint8_t* report, int len, uint16_t interface) {
+// Returns false if there's nothing new for process_mapping().
+bool handle_received_report(const uint8_t* report, int len, uint16_t interface) {
     led_state = !led_state;
     board_led_write(led_state);
     reports_received++;
 
-    mutex_enter_blocking(&their_usages_mutex);
-
-    uint8_t report_id = 0;
-    if (has_report_id_theirs[interface]) {
-        report_id = report[0];
-        report++;
-        len--;
+    bool decoded = false;
+    interface_plan_t* plan = NULL;
+    for (uint8_t i = 0; i < interface_plan_count; i++) {
+        if (interface_plans[i].interface == interface) {
+            plan = &interface_plans[i];
+            break;
+        }
     }
 
-    for (auto const& [their_usage, their_usage_def] : their_usages[interface][report_id]) {
-        read_input(report, len, their_usage, their_usage_def, interface);
+    // the plan is stale if the descriptor changed or the device went away since it was built
+    if ((plan != NULL) && (plan->generation == interface_generation[plan->index])) {
+        uint8_t report_id = 0;
+        if (plan->has_report_id) {
+            report_id = report[0];
+            report++;
+            len--;
+        }
+
+        plan->received++;
+        if (report_id + 1u < plan->report_starts.size()) {
+            raw_report_cache_t& raw_report = plan->raw_reports[report_id];
+            if (is_duplicate(*plan, raw_report, report_id, report, len)) {
+                plan->duplicates++;
+            } else {
+                const extract_op_t* ops = plan->ops.data();
+                for (uint16_t i = plan->report_starts[report_id]; i < plan->report_starts[report_id + 1]; i++) {
+                    read_input(report, len, ops[i], plan->index_mask);
+                }
+                for (uint16_t i = plan->array_report_starts[report_id]; i < plan->array_report_starts[report_id + 1]; i++) {
+                    read_array_input(report, len, plan->array_ops[i], *plan);
+                }
+                raw_report.report.assign(report, report + len);
+                plan->last_report_id = report_id;
+                decoded = true;
+            }
+        }
     }
 
-    mutex_exit(&their_usages_mutex);
+    return decoded;
 }
 
 void rlencode(const std::set<uint32_t>& usages, std::vector<usage_rle_t>& output) {
@@ -554,55 +1669,34 @@ void rlencode(const std::set<uint32_t>& usages, std::vector<usage_rle_t>& output
     }
 }
 
-void update_their_descriptor_derivates() {
-    relative_usages.clear();
-    relative_usage_set.clear();
+// Only done when the config tool asks for it.
+void update_their_usages_rle() {
+    if (!their_usages_rle_stale) {
+        return;
+    }
     std::set<uint32_t> their_usages_set;
-    for (auto const& [interface, report_id_usage_map] : their_usages) {
-        for (auto const& [report_id, usage_map] : report_id_usage_map) {
-            for (auto const& [usage, usage_def] : usage_map) {
-                their_usages_set.insert(usage);
-                if (usage_def.is_relative) {
-                    relative_usages.push_back(usage);
-                    relative_usage_set.insert(usage);
-                }
-            }
-        }
+    for (auto const& [usage, refs] : their_usage_refs) {
+        their_usages_set.insert(usage);
     }
-
     their_usages_rle.clear();
     rlencode(their_usages_set, their_usages_rle);
+    their_usages_rle_stale = false;
 }
 
+// The parsing itself happens at compile time (see our_descriptor_layout.h),
+// this just fills in the lookup structures that the rest of the code uses.
 void parse_our_descriptor() {
-    bool has_report_id_ours;
-    std::unordered_map<uint8_t, uint16_t> report_sizes_map = parse_descriptor(our_usages, has_report_id_ours, our_report_descriptor, our_report_descriptor_length);
-    for (auto const& [report_id, size] : report_sizes_map) {
-        report_sizes[report_id] = size;
-        reports[report_id] = new uint8_t[size];
-        memset(reports[report_id], 0, size);
-        prev_reports[report_id] = new uint8_t[size];
-        memset(prev_reports[report_id], 0, size);
-        report_masks_relative[report_id] = new uint8_t[size];
-        memset(report_masks_relative[report_id], 0, size);
-        report_masks_absolute[report_id] = new uint8_t[size];
-        memset(report_masks_absolute[report_id], 0, size);
-
-        report_ids.push_back(report_id);
+    for (uint8_t report_id = 1; report_id <= MAX_INPUT_REPORT_ID; report_id++) {
+        if (report_sizes[report_id] > 0) {
+            prev_reports[report_id] = prev_storage[report_id];
+            report_ids.push_back(report_id);
+        }
     }
 
     std::set<uint32_t> our_usages_set;
-    for (auto const& [report_id, usage_map] : our_usages) {
-        for (auto const& [usage, usage_def] : usage_map) {
-            our_usages_flat[usage] = usage_def;
-            our_usages_set.insert(usage);
-
-            if (usage_def.is_relative) {
-                put_bits(report_masks_relative[report_id], report_sizes[report_id], usage_def.bitpos, usage_def.size, 0xFFFFFFFF);
-            } else {
-                put_bits(report_masks_absolute[report_id], report_sizes[report_id], usage_def.bitpos, usage_def.size, 0xFFFFFFFF);
-            }
-        }
+    for (auto const& [usage, usage_def] : OUR_LAYOUT.usages) {
+        our_usages_flat[usage] = usage_def;
+        our_usages_set.insert(usage);
     }
 
     rlencode(our_usages_set, our_usages_rle);
@@ -611,7 +1705,31 @@ void parse_our_descriptor() {
 void print_stats() {
     uint64_t now = time_us_64();
     if (now > next_print) {
-        printf("%ld %ld\n", reports_received, reports_sent);
+        printf("%ld %ld", reports_received, reports_sent);
+        for (auto queue : { &edge_queue, &motion_queue }) {
+            // average and max time spent in the queue in microseconds, merged, deferred and dropped reports
+            printf(" %ld/%ld m%ld d%ld x%ld", queue->sent ? queue->latency_sum / queue->sent : 0, queue->latency_max, queue->merged, queue->deferred, queue->dropped);
+            queue->sent = 0;
+            queue->latency_sum = 0;
+            queue->latency_max = 0;
+            queue->merged = 0;
+            queue->deferred = 0;
+            queue->dropped = 0;
+        }
+        for (auto report_id : report_ids) {
+            printf(" %d:%ld/%ld", report_id, report_sent[report_id] ? report_latency_sum[report_id] / report_sent[report_id] : 0, report_latency_max[report_id]);
+            report_sent[report_id] = 0;
+            report_latency_sum[report_id] = 0;
+            report_latency_max[report_id] = 0;
+        }
+        // duplicate reports that weren't decoded / all reports, per interface
+        for (uint8_t i = 0; i < interface_plan_count; i++) {
+            interface_plan_t& plan = interface_plans[i];
+            printf(" %04x:%ld/%ld", plan.interface, plan.duplicates, plan.received);
+            plan.duplicates = 0;
+            plan.received = 0;
+        }
+        printf("\n");
         reports_received = 0;
         reports_sent = 0;
         while (next_print < now) {
@@ -663,8 +1781,9 @@ int main() {
         }
 
         if (their_descriptor_updated) {
-            update_their_descriptor_derivates();
+            // cleared first so that a change on the other core while we're at it isn't lost
             their_descriptor_updated = false;
+            update_their_descriptor_derivates();
         }
         if (need_to_persist_config) {
             persist_config();
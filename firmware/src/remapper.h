@@ -2,12 +2,16 @@
 #define _REMAPPER_H_
 
 void set_mapping_from_config();
-void handle_received_report(const uint8_t* report, int len, uint16_t interface);
+bool handle_received_report(const uint8_t* report, int len, uint16_t interface);
 
 void extra_init();
 bool read_report();
 
 void interval_override_updated();
 void screens_updated();
+void offscreen_sensitivity_updated();
+void report_priority_updated();
+void resolution_multiplier_updated();
+void update_their_usages_rle();
 
 #endif
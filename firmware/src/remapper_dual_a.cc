@@ -10,6 +10,8 @@ void send_b_init() {
     serial_write((uint8_t*) &msg, sizeof(msg));
 }
 
+bool report_decoded;
+
 void serial_callback(const uint8_t* data, uint16_t len) {
     switch ((DualCommand) data[0]) {
         case DualCommand::DEVICE_CONNECTED: {
@@ -24,7 +26,7 @@ void serial_callback(const uint8_t* data, uint16_t len) {
         }
         case DualCommand::REPORT_RECEIVED: {
             report_received_t* msg = (report_received_t*) data;
-            handle_received_report(msg->report, len - sizeof(report_received_t), (uint16_t) (msg->dev_addr << 8) | msg->interface);
+            report_decoded |= handle_received_report(msg->report, len - sizeof(report_received_t), (uint16_t) (msg->dev_addr << 8) | msg->interface);
             break;
         }
         case DualCommand::REQUEST_B_INIT:
@@ -40,7 +42,9 @@ void extra_init() {
 }
 
 bool read_report() {
-    return serial_read(serial_callback);
+    report_decoded = false;
+    serial_read(serial_callback);
+    return report_decoded;
 }
 
 void interval_override_updated() {
@@ -9,6 +9,14 @@
 #define SERIAL_UART uart0
 
 #define FORWARDER_BAUDRATE 1000000
+// [FORWARDER_CHAIN_MARKER, address, report_id, report...] is for a forwarder further down the chain
+#define FORWARDER_CHAIN_MARKER 0xFF
+// [FORWARDER_HIRES_MARKER, timeout_lo, timeout_hi, report_id, report...] has hi-res scroll in it
+// (RESOLUTION_MULTIPLIER per wheel click), what's left of partial clicks is dropped after the
+// timeout (in milliseconds). Reports with scroll in them are only sent this way to screens with
+// SCREEN_FLAG_HIRES_FORWARDER, an older forwarder would pass them on with report ID 0xFE, which
+// its host ignores. Otherwise [report_id, report...] has scroll in wheel clicks.
+#define FORWARDER_HIRES_MARKER 0xFE
 
 typedef void (*msg_recv_cb_t)(const uint8_t* data, uint16_t len);
 
@@ -0,0 +1,152 @@
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Deadlines counted in ticks (start-of-frame, so milliseconds). Timers are
+// identified by small integers (slots) and kept in doubly linked bucket lists,
+// so scheduling and cancelling are O(1). Level 0 has a bucket per tick, every
+// level above that a bucket per 64 ticks of the level below. Timers further
+// out than the top level covers sit in its last bucket and get re-bucketed
+// when it comes up. Nothing in here knows what time it is, the clock only
+// moves in timer_advance().
+
+#define TIMER_LEVELS 3
+#define TIMER_LEVEL_BITS 6
+#define TIMER_BUCKETS (1 << TIMER_LEVEL_BITS)
+#define NO_TIMER 0xFFFF
+#define NO_BUCKET 0xFF
+
+struct timer_entry_t {
+    uint32_t deadline;
+    uint16_t prev = NO_TIMER;
+    uint16_t next = NO_TIMER;
+    uint8_t bucket = NO_BUCKET;  // level * TIMER_BUCKETS + index
+};
+
+struct timer_wheel_t {
+    uint32_t now = 0;
+    std::vector<timer_entry_t> timers;  // id -> ...
+    uint16_t buckets[TIMER_LEVELS * TIMER_BUCKETS];
+    std::vector<uint16_t> expired;  // scratch for timer_advance()
+    timer_wheel_t() {
+        for (auto& head : buckets) {
+            head = NO_TIMER;
+        }
+    }
+};
+
+inline bool timer_pending(const timer_wheel_t& wheel, uint16_t id) {
+    return wheel.timers[id].bucket != NO_BUCKET;
+}
+
+inline void timer_unlink(timer_wheel_t& wheel, uint16_t id) {
+    timer_entry_t& timer = wheel.timers[id];
+    if (timer.prev != NO_TIMER) {
+        wheel.timers[timer.prev].next = timer.next;
+    } else {
+        wheel.buckets[timer.bucket] = timer.next;
+    }
+    if (timer.next != NO_TIMER) {
+        wheel.timers[timer.next].prev = timer.prev;
+    }
+    timer.prev = NO_TIMER;
+    timer.next = NO_TIMER;
+    timer.bucket = NO_BUCKET;
+}
+
+inline void timer_link(timer_wheel_t& wheel, uint16_t id) {
+    timer_entry_t& timer = wheel.timers[id];
+    uint8_t bucket = NO_BUCKET;
+    for (uint8_t level = 0; level < TIMER_LEVELS; level++) {
+        uint8_t shift = level * TIMER_LEVEL_BITS;
+        // how many buckets of this level away from the current one (mod 2^32 ticks)
+        if ((((timer.deadline >> shift) - (wheel.now >> shift)) & (UINT32_MAX >> shift)) < TIMER_BUCKETS) {
+            bucket = level * TIMER_BUCKETS + ((timer.deadline >> shift) & (TIMER_BUCKETS - 1));
+            break;
+        }
+    }
+    if (bucket == NO_BUCKET) {  // too far out, park it in the last bucket of the top level
+        uint8_t shift = (TIMER_LEVELS - 1) * TIMER_LEVEL_BITS;
+        bucket = (TIMER_LEVELS - 1) * TIMER_BUCKETS + (((wheel.now >> shift) - 1) & (TIMER_BUCKETS - 1));
+    }
+    timer.bucket = bucket;
+    timer.prev = NO_TIMER;
+    timer.next = wheel.buckets[bucket];
+    if (timer.next != NO_TIMER) {
+        wheel.timers[timer.next].prev = id;
+    }
+    wheel.buckets[bucket] = id;
+}
+
+// Fires at the first timer_advance() that gets to now + delay (delay is at
+// least 1). Rescheduling a pending timer moves it.
+inline void timer_schedule(timer_wheel_t& wheel, uint16_t id, uint32_t delay) {
+    if (timer_pending(wheel, id)) {
+        timer_unlink(wheel, id);
+    }
+    wheel.timers[id].deadline = wheel.now + (delay ? delay : 1);
+    timer_link(wheel, id);
+}
+
+inline void timer_cancel(timer_wheel_t& wheel, uint16_t id) {
+    if (timer_pending(wheel, id)) {
+        timer_unlink(wheel, id);
+    }
+}
+
+// Ticks left until a pending timer fires.
+inline uint32_t timer_remaining(const timer_wheel_t& wheel, uint16_t id) {
+    return wheel.timers[id].deadline - wheel.now;
+}
+
+// Drops all timers and makes room for ids up to n - 1. The clock keeps going.
+inline void timer_wheel_reset(timer_wheel_t& wheel, uint16_t n) {
+    wheel.timers.assign(n, timer_entry_t());
+    for (auto& head : wheel.buckets) {
+        head = NO_TIMER;
+    }
+}
+
+// Moves the clock by one tick and calls expired(id) for every timer whose
+// deadline that was. The callback can schedule timers again.
+template <typename F>
+void timer_advance(timer_wheel_t& wheel, F&& expired) {
+    wheel.now++;
+    // when a level wraps around, the next bucket of the level above gets
+    // spread out over the levels below
+    for (uint8_t level = TIMER_LEVELS - 1; level > 0; level--) {
+        uint8_t shift = level * TIMER_LEVEL_BITS;
+        if ((wheel.now & ((1 << shift) - 1)) != 0) {
+            continue;
+        }
+        uint8_t bucket = level * TIMER_BUCKETS + ((wheel.now >> shift) & (TIMER_BUCKETS - 1));
+        uint16_t id = wheel.buckets[bucket];
+        wheel.buckets[bucket] = NO_TIMER;
+        while (id != NO_TIMER) {
+            uint16_t next = wheel.timers[id].next;
+            timer_link(wheel, id);
+            id = next;
+        }
+    }
+
+    // everything in the current level 0 bucket is due now, take it all out
+    // first so that the callbacks can do what they want with the wheel
+    uint8_t bucket = wheel.now & (TIMER_BUCKETS - 1);
+    wheel.expired.clear();
+    for (uint16_t id = wheel.buckets[bucket]; id != NO_TIMER;) {
+        timer_entry_t& timer = wheel.timers[id];
+        wheel.expired.push_back(id);
+        id = timer.next;
+        timer.prev = NO_TIMER;
+        timer.next = NO_TIMER;
+        timer.bucket = NO_BUCKET;
+    }
+    wheel.buckets[bucket] = NO_TIMER;
+    for (auto id : wheel.expired) {
+        expired(id);
+    }
+}
+
+#endif
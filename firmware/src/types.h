@@ -2,6 +2,10 @@
 #define _TYPES_H_
 
 #include <stdint.h>
+#include <vector>
+
+#include "fixed_point.h"
+#include "our_descriptor.h"
 
 enum class ConfigCommand : int8_t {
     NO_COMMAND = 0,
@@ -20,15 +24,89 @@ enum class ConfigCommand : int8_t {
     GET_SCREEN = 13,
 };
 
+#define NO_SLOT 0xFFFF
+
+// how get_bits()/put_bits() get at a field, picked by bits_kernel()
+enum class BitsKernel : uint8_t {
+    BITWISE = 0,  // fields we can't do better for (empty or wider than 32 bits)
+    GENERIC = 1,
+    BIT = 2,
+    U8 = 3,   // byte aligned
+    U16 = 4,  // byte aligned
+    U32 = 5,  // byte aligned
+};
+
 struct usage_def_t {
     uint8_t report_id;
     uint8_t size;
     uint16_t bitpos;
     bool is_relative;
-    bool is_array = false;
     int32_t logical_minimum;
-    uint32_t index = 0;  // for arrays
     uint32_t count = 0;  // for arrays
+    uint16_t slot = NO_SLOT;
+    BitsKernel kernel = BitsKernel::BITWISE;
+};
+
+// An array field of their report. Array values don't get a usage_def_t each,
+// consumer control arrays can have hundreds of them.
+struct their_array_t {
+    usage_def_t def;               // the whole field, count elements of size bits
+    std::vector<uint32_t> usages;  // array value - logical minimum -> usage, 0 if it doesn't have its own
+};
+
+// One field of their report and the input_state slot it goes to. These are
+// built when usages are interned (that's when the slots are known).
+struct extract_op_t {
+    uint16_t bitpos;
+    uint8_t size;
+    BitsKernel kernel;
+    uint16_t slot;
+    uint8_t flags;
+};
+
+// An array field of their report. Its elements are read once into a bitmap of
+// the array values that are present and only the usages whose bit changed since
+// the previous report get updated.
+struct array_extract_op_t {
+    uint16_t bitpos;
+    uint8_t size;
+    BitsKernel kernel;
+    uint32_t count;           // elements
+    uint32_t first_value;     // logical minimum
+    uint32_t nvalues;         // logical maximum - logical minimum + 1
+    uint32_t slots_start;     // into interface_plan_t::array_slots
+    uint32_t presence_start;  // into interface_plan_t::array_presence
+    uint8_t flags;
+};
+
+// Last raw report received with a given report ID. If the next one is the
+// same, decoding it wouldn't change anything.
+struct raw_report_cache_t {
+    std::vector<uint8_t> report;         // empty if nothing cached
+    std::vector<uint8_t> relative_mask;  // relative fields have to be zero for a report to be skipped
+    bool cacheable = true;               // false if there are relative arrays
+};
+
+#define MAX_INTERFACES 32
+
+struct interface_plan_t {
+    uint16_t interface;  // dev_addr+interface
+    bool has_report_id;
+    uint8_t index;                         // interface_index
+    uint32_t index_mask;                   // 1 << interface_index
+    uint32_t generation;                   // interface_generation[index] when the plan was built
+    std::vector<extract_op_t> ops;         // grouped by report ID, sorted by bit position
+    std::vector<uint16_t> report_starts;  // report_id -> index into ops (plus end)
+    std::vector<array_extract_op_t> array_ops;
+    std::vector<uint16_t> array_report_starts;  // report_id -> index into array_ops (plus end)
+    std::vector<uint16_t> array_slots;          // array value -> slot, NO_SLOT if it doesn't have its own usage
+    std::vector<uint32_t> array_presence;       // bitmap of array values present in the last report
+    std::vector<raw_report_cache_t> raw_reports;  // report_id -> ...
+    bool shared_slots;       // different report IDs write to some of the same slots
+    uint8_t last_report_id;  // last one decoded
+    // since last print_stats()
+    uint32_t received;
+    uint32_t duplicates;
 };
 
 struct map_source_t {
@@ -38,6 +116,24 @@ struct map_source_t {
     uint8_t layer = 0;
 };
 
+// One step of the mapping program that set_mapping_from_config() compiles from
+// reverse_mapping. Everything that doesn't change between ticks is resolved
+// up front so process_mapping() can just run through the list.
+struct map_op_t {
+    uint16_t source_slot;
+    uint16_t target_slot;
+    uint16_t sticky_slot;
+    uint16_t bitpos;    // target
+    int32_t scaling;    // Q16.16
+    uint8_t report_id;  // target
+    uint8_t size;       // target
+    BitsKernel kernel;  // target
+    uint8_t layer;
+    uint8_t flags;
+    uint8_t resolution_mask;  // non-zero for scroll targets
+    uint16_t scroll_index;    // lo-res accumulator, for scroll targets
+};
+
 struct usage_rle_t {
     uint32_t usage;
     uint32_t count;
@@ -69,15 +165,41 @@ enum class ConstraintMode : int8_t {
     VISIBLE = 2,
 };
 
+enum class ScreenRoute : uint8_t {
+    LOCAL_USB = 0,
+    FORWARDER = 1,
+};
+
+// the forwarder of the screen takes hi-res scroll (FORWARDER_HIRES_MARKER frames, see serial.h)
+#define SCREEN_FLAG_HIRES_FORWARDER 0x01
+
 struct __attribute__((packed)) screen_def_t {
     uint32_t x;
     uint32_t y;
     uint32_t w;
     uint32_t h;
     uint32_t sensitivity;
+    ScreenRoute route;
+    uint8_t forwarder_address;  // 0 is the forwarder connected to us, 1 is the one connected to it, etc.
+    uint8_t flags;              // SCREEN_FLAG_*
+};
+
+struct screen_params_t {
+    int32_t x;
+    int32_t y;
+    int32_t x_end;
+    int32_t y_end;
+    uint32_t sensitivity;
+    coordinate_scale_t x_scale;
+    coordinate_scale_t y_scale;
+    ScreenRoute route;
+    uint8_t forwarder_address;
+    bool hires_forwarder;           // SCREEN_FLAG_HIRES_FORWARDER
+    uint8_t resolution_multiplier;  // what the host of this screen has enabled, as far as we're concerned
+    bool overlapped;                // part of it is covered by a screen with a lower index
 };
 
-#define NSCREENS 2
+#define MAX_SCREENS 8
 
 struct __attribute__((packed)) persist_config_t {
     uint8_t version;
@@ -87,7 +209,9 @@ struct __attribute__((packed)) persist_config_t {
     uint8_t interval_override;
     ConstraintMode constraint_mode;
     uint32_t offscreen_sensitivity;
-    screen_def_t screens[NSCREENS];
+    uint8_t screen_count;
+    uint8_t report_priority[MAX_INPUT_REPORT_ID];
+    screen_def_t screens[MAX_SCREENS];
 };
 
 struct __attribute__((packed)) get_config_t {
@@ -100,6 +224,8 @@ struct __attribute__((packed)) get_config_t {
     uint8_t interval_override;
     ConstraintMode constraint_mode;
     uint32_t offscreen_sensitivity;
+    uint8_t screen_count;
+    uint8_t report_priority[MAX_INPUT_REPORT_ID];
 };
 
 struct __attribute__((packed)) set_config_t {
@@ -108,6 +234,8 @@ struct __attribute__((packed)) set_config_t {
     uint8_t interval_override;
     ConstraintMode constraint_mode;
     uint32_t offscreen_sensitivity;
+    uint8_t screen_count;
+    uint8_t report_priority[MAX_INPUT_REPORT_ID];
 };
 
 struct __attribute__((packed)) get_indexed_t {
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "bits.h"
+
+// get_bits()/put_bits() a bit at a time against the kernel picked for the
+// field, for the kinds of fields that show up in reports.
+
+struct field_t {
+    const char* name;
+    uint16_t bitpos;
+    uint8_t size;
+};
+
+const field_t FIELDS[] = {
+    { "button (1 bit)", 3, 1 },
+    { "key (8 bits)", 16, 8 },
+    { "X (16 bits)", 8, 16 },
+    { "X (12 bits)", 12, 12 },
+    { "X (32 bits)", 32, 32 },
+};
+
+template <typename F>
+double time_per_call(F&& f, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        f(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 10000000;
+
+    volatile uint8_t report[16] = {};
+    volatile uint32_t sink = 0;
+
+    printf("field             get bitwise  get kernel  put bitwise  put kernel (ns)\n");
+    for (auto const& field : FIELDS) {
+        BitsKernel kernel = bits_kernel(field.bitpos, field.size);
+        uint8_t* data = (uint8_t*) report;
+        double get_bitwise = time_per_call([&](int i) { sink = sink + get_bits(data, sizeof(report), field.bitpos, field.size); }, rounds);
+        double get_kernel = time_per_call([&](int i) { sink = sink + get_bits(data, sizeof(report), field.bitpos, field.size, kernel); }, rounds);
+        double put_bitwise = time_per_call([&](int i) { put_bits(data, sizeof(report), field.bitpos, field.size, i); }, rounds);
+        double put_kernel = time_per_call([&](int i) { put_bits(data, sizeof(report), field.bitpos, field.size, i, kernel); }, rounds);
+        printf("%-16s  %11.2f  %10.2f  %11.2f  %10.2f\n", field.name, get_bitwise, get_kernel, put_bitwise, put_kernel);
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <string.h>
+
+#include <random>
+
+#include "bits.h"
+#include "check.h"
+
+// The kernels in bits.h against the bit at a time versions, for every field
+// position and size in the first 12 bytes and every report length up to 16
+// bytes, with random data. A put has to leave every byte it shouldn't touch
+// alone, including the ones past the end of the report.
+
+const int MAX_LEN = 16;
+const int GUARD = 8;
+
+std::mt19937 rng(1);
+
+void check_kernel(uint16_t bitpos, uint8_t size, int len, BitsKernel kernel) {
+    uint8_t data[MAX_LEN + GUARD];
+    for (auto& b : data) {
+        b = rng();
+    }
+    CHECK(get_bits(data, len, bitpos, size, kernel) == get_bits(data, len, bitpos, size));
+
+    uint32_t value = rng();
+    uint8_t expected[MAX_LEN + GUARD];
+    memcpy(expected, data, sizeof(data));
+    put_bits(expected, len, bitpos, size, value);
+    put_bits(data, len, bitpos, size, value, kernel);
+    CHECK(memcmp(data, expected, sizeof(data)) == 0);
+}
+
+int main() {
+    for (uint16_t bitpos = 0; bitpos <= 96; bitpos++) {
+        for (uint8_t size = 0; size <= 40; size++) {
+            for (int len = 0; len <= MAX_LEN; len++) {
+                for (int i = 0; i < 8; i++) {
+                    check_kernel(bitpos, size, len, bits_kernel(bitpos, size));
+                    // the generic kernel has to work for anything it could be picked for
+                    if ((size >= 1) && (size <= 32)) {
+                        check_kernel(bitpos, size, len, BitsKernel::GENERIC);
+                    }
+                }
+            }
+        }
+    }
+
+    // what gets picked
+    CHECK(bits_kernel(0, 0) == BitsKernel::BITWISE);
+    CHECK(bits_kernel(0, 33) == BitsKernel::BITWISE);
+    CHECK(bits_kernel(3, 1) == BitsKernel::BIT);
+    CHECK(bits_kernel(8, 8) == BitsKernel::U8);
+    CHECK(bits_kernel(16, 16) == BitsKernel::U16);
+    CHECK(bits_kernel(24, 32) == BitsKernel::U32);
+    CHECK(bits_kernel(4, 8) == BitsKernel::GENERIC);
+    CHECK(bits_kernel(8, 12) == BitsKernel::GENERIC);
+
+    return 0;
+}
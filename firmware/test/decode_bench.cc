@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <random>
+
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "remapper.h"
+
+// Time per incoming report, just decoding it (handle_received_report()) and
+// decoding plus mapping and queueing (one pass of the main loop), for a mouse,
+// a keyboard and a composite device with three report IDs behind a hub, with
+// a second keyboard and mouse plugged in that stay quiet.
+
+const uint16_t MOUSE = interface_of(2, 0);
+const uint16_t KEYBOARD = interface_of(3, 0);
+const uint16_t COMPOSITE = interface_of(4, 1);
+const uint16_t IDLE_MOUSE = interface_of(5, 0);
+const uint16_t IDLE_KEYBOARD = interface_of(6, 0);
+
+std::vector<received_t> make_replay(int n, bool mouse, bool keyboard, bool composite) {
+    std::mt19937 rng(1);
+    std::vector<received_t> replay;
+    mouse_report_t mouse_report = {};
+    keyboard_report_t kbd = {};
+    while ((int) replay.size() < n) {
+        if (mouse) {
+            mouse_report.x = (int16_t) (rng() % 21) - 10;
+            mouse_report.y = (int16_t) (rng() % 21) - 10;
+            if (rng() % 64 == 0) {
+                mouse_report.buttons ^= 1;
+            }
+            replay.push_back({ MOUSE, std::vector<uint8_t>((uint8_t*) &mouse_report, (uint8_t*) &mouse_report + sizeof(mouse_report)) });
+        }
+        if (keyboard && (rng() % 4 == 0)) {
+            kbd.keys[rng() % 6] = (rng() % 3) ? 0x04 + rng() % 98 : 0;
+            replay.push_back({ KEYBOARD, std::vector<uint8_t>((uint8_t*) &kbd, (uint8_t*) &kbd + sizeof(kbd)) });
+        }
+        if (composite && (rng() % 4 == 0)) {
+            uint8_t report_id = 1 + rng() % 3;
+            std::vector<uint8_t> report = { report_id, 0, 0, 0, 0 };
+            for (size_t i = 1; i < report.size(); i++) {
+                report[i] = (rng() % 2) ? 0x04 + rng() % 8 : 0;
+            }
+            if (report_id == 2) {
+                report.resize(2);
+            }
+            replay.push_back({ COMPOSITE, report });
+        }
+    }
+    return replay;
+}
+
+double decode_only(const std::vector<received_t>& replay) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto const& received : replay) {
+        handle_received_report(received.report.data(), received.report.size(), received.interface);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / replay.size();
+}
+
+double decode_and_map(const std::vector<received_t>& replay) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto const& received : replay) {
+        host_received.push_back(received);
+        host_loop();
+        host_time_us += 250;
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / replay.size();
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : 200000;
+
+    host_capture = false;
+    FILE* out = host_init();
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    parse_descriptor(0x1234, 0x0003, COMPOSITE_DESCRIPTOR, sizeof(COMPOSITE_DESCRIPTOR), COMPOSITE);
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), IDLE_MOUSE);
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), IDLE_KEYBOARD);
+    update_their_descriptor_derivates();
+    their_descriptor_updated = false;
+
+    struct {
+        const char* name;
+        std::vector<received_t> replay;
+    } workloads[] = {
+        { "mouse", make_replay(n, true, false, false) },
+        { "keyboard", make_replay(n, false, true, false) },
+        { "composite", make_replay(n, false, false, true) },
+        { "all three", make_replay(n, true, true, true) },
+    };
+
+    fprintf(out, "reports     decode  decode+map (ns/report)\n");
+    for (auto const& workload : workloads) {
+        decode_only(workload.replay);  // warm up
+        double decode = decode_only(workload.replay);
+        double map = decode_and_map(workload.replay);
+        fprintf(out, "%-10s  %6.0f  %10.0f\n", workload.name, decode, map);
+    }
+
+    return 0;
+}
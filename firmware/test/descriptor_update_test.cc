@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "remapper.h"
+
+// update_their_descriptor_derivates() only rebuilds the plans of interfaces
+// that changed when the set of usages (and which of them are relative) stays
+// the same. Devices get plugged, unplugged and parsed again at random and
+// after every update the plans and slots have to be what a full rebuild
+// (set_mapping_from_config()) makes of the same descriptors.
+
+struct device_t {
+    uint16_t interface;
+    const uint8_t* descriptor;
+    int len;
+};
+
+const device_t DEVICES[] = {
+    { interface_of(2, 0), MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR) },
+    { interface_of(3, 0), KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR) },
+    { interface_of(4, 0), KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR) },
+    { interface_of(4, 1), COMPOSITE_DESCRIPTOR, sizeof(COMPOSITE_DESCRIPTOR) },
+    { interface_of(5, 0), KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR) },
+    { interface_of(6, 0), MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR) },
+};
+
+// remapper.cc
+extern std::unordered_map<uint32_t, uint16_t> usage_slots;
+extern bool evaluate_all_targets;
+
+std::string snapshot() {
+    std::vector<std::string> plans;
+    for (uint8_t i = 0; i < interface_plan_count; i++) {
+        const interface_plan_t& plan = interface_plans[i];
+        std::string s = std::to_string(plan.interface) + " " + std::to_string(plan.has_report_id) + " " +
+                        std::to_string(plan.index) + " " + std::to_string(plan.generation) + " " +
+                        std::to_string(plan.shared_slots) + "\n ops";
+        for (auto const& op : plan.ops) {
+            s += " " + std::to_string(op.bitpos) + "/" + std::to_string(op.size) + "/" + std::to_string((int) op.kernel) +
+                 "/" + std::to_string(op.slot) + "/" + std::to_string(op.flags);
+        }
+        s += "\n starts";
+        for (auto start : plan.report_starts) {
+            s += " " + std::to_string(start);
+        }
+        s += "\n arrays";
+        for (auto const& op : plan.array_ops) {
+            s += " " + std::to_string(op.bitpos) + "/" + std::to_string(op.size) + "/" + std::to_string(op.count) +
+                 "/" + std::to_string(op.first_value) + "/" + std::to_string(op.nvalues) +
+                 "/" + std::to_string(op.slots_start) + "/" + std::to_string(op.flags);
+        }
+        for (auto start : plan.array_report_starts) {
+            s += " " + std::to_string(start);
+        }
+        s += "\n array slots";
+        for (auto slot : plan.array_slots) {
+            s += " " + std::to_string(slot);
+        }
+        plans.push_back(s + "\n");
+    }
+    std::sort(plans.begin(), plans.end());
+
+    std::vector<std::pair<uint32_t, uint16_t>> slots(usage_slots.begin(), usage_slots.end());
+    std::sort(slots.begin(), slots.end());
+    std::string s;
+    for (auto const& plan : plans) {
+        s += plan;
+    }
+    for (auto const& [usage, slot] : slots) {
+        s += std::to_string(usage) + ":" + std::to_string(slot) + " ";
+    }
+    return s;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    config_mappings.push_back({ .target_usage = 0x00090001, .source_usage = 0x00070004, .scaling = 1000 });
+    config_mappings.push_back({ .target_usage = 0x00010038, .source_usage = 0x00070005, .scaling = 250 });
+    config_mappings.push_back({ .target_usage = 0x00070006, .source_usage = 0x00010030, .scaling = 1000 });
+    host_init();
+
+    int incremental = 0;
+    int full = 0;
+    for (int i = 0; i < 5000; i++) {
+        int events = 1 + rng() % 2;
+        for (int j = 0; j < events; j++) {
+            const device_t& device = DEVICES[rng() % (sizeof(DEVICES) / sizeof(DEVICES[0]))];
+            if (rng() % 3) {
+                parse_descriptor(0x1234, 0x5678, device.descriptor, device.len, device.interface);
+            } else {
+                clear_descriptor_data(device.interface >> 8);
+            }
+        }
+        their_descriptor_updated = false;
+        evaluate_all_targets = false;
+        update_their_descriptor_derivates();
+        CHECK(!their_descriptor_updated);
+        // only the full rebuild compiles the mapping program
+        if (!evaluate_all_targets) {
+            incremental++;
+        } else {
+            full++;
+        }
+
+        std::string updated = snapshot();
+        set_mapping_from_config();
+        CHECK(snapshot() == updated);
+    }
+    // both ways have to have been taken, a lot
+    CHECK(incremental > 500);
+    CHECK(full > 500);
+
+    return 0;
+}
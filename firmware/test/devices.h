@@ -0,0 +1,65 @@
+#ifndef _DEVICES_H_
+#define _DEVICES_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "host.h"
+
+// Report descriptors of the devices the tests plug in and the reports they send.
+
+// 5 buttons, 16-bit X and Y, wheel, AC pan
+const uint8_t MOUSE_DESCRIPTOR[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x81, 0x06,
+    0x09, 0x38, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x81, 0x06,
+    0x05, 0x0C, 0x0A, 0x38, 0x02, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x81, 0x06,
+    0xC0, 0xC0
+};
+
+struct __attribute__((packed)) mouse_report_t {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int8_t wheel;
+    int8_t pan;
+};
+
+// boot protocol keyboard: modifier bitmap and a 6 key array
+const uint8_t KEYBOARD_DESCRIPTOR[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+    0xC0
+};
+
+struct __attribute__((packed)) keyboard_report_t {
+    uint8_t modifiers;
+    uint8_t reserved;
+    uint8_t keys[6];
+};
+
+// report ID 1: 4 key array, report ID 2: bitmap of keys 0x04-0x0B (the same
+// usages as in report 1), report ID 3: consumer control array
+const uint8_t COMPOSITE_DESCRIPTOR[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,
+    0x95, 0x04, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+    0x85, 0x02, 0x05, 0x07, 0x19, 0x04, 0x29, 0x0B, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x85, 0x03, 0x05, 0x0C, 0x19, 0x00, 0x2A, 0x3C, 0x02, 0x15, 0x00, 0x26, 0x3C, 0x02, 0x75, 0x10, 0x95, 0x02, 0x81, 0x00,
+    0xC0
+};
+
+inline uint16_t interface_of(uint8_t dev_addr, uint8_t itf) {
+    return (dev_addr << 8) | itf;
+}
+
+template <typename T>
+void receive(uint16_t interface, const T& report) {
+    host_received.push_back({ interface, std::vector<uint8_t>((const uint8_t*) &report, (const uint8_t*) &report + sizeof(report)) });
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "fixed_point.h"
+
+// Mapping a value, adding it up, flushing whole units and moving the cursor,
+// in Q16.16 and the way it used to be done in units of 1/1000. Then turning
+// the cursor position into our absolute X, with local_coordinate() and with a
+// 64-bit divide. On the RP2040 the difference is bigger than here: there's no
+// divide instruction there and no 64-bit multiply either.
+
+const int N = 4096;
+
+struct input_t {
+    int32_t value;
+    int32_t scaling;  // * 1000 for the old code, Q16.16 for the new one
+    uint32_t sensitivity;
+};
+
+__attribute__((noinline)) int64_t run_old(const std::vector<input_t>& inputs) {
+    int32_t acc = 0;
+    int64_t cursor = 0;
+    int64_t out = 0;
+    for (auto const& input : inputs) {
+        acc += input.value * input.scaling;
+        int32_t truncated = acc / 1000;
+        acc -= truncated * 1000;
+        out += truncated;
+        cursor += (int64_t) acc * input.sensitivity / 1000;
+    }
+    return out + cursor;
+}
+
+__attribute__((noinline)) int64_t run_new(const std::vector<input_t>& inputs) {
+    int32_t acc = 0;
+    int32_t cursor = 0;
+    int64_t out = 0;
+    for (auto const& input : inputs) {
+        acc = add_saturating(acc, mul_saturating(input.value, input.scaling));
+        int32_t truncated = acc / FIXED_ONE;
+        acc -= truncated * FIXED_ONE;
+        out += truncated;
+        cursor = add_saturating(cursor, scale_movement(acc, input.sensitivity));
+    }
+    return out + cursor;
+}
+
+__attribute__((noinline)) uint32_t local_old(const std::vector<uint32_t>& offsets, uint32_t size) {
+    uint32_t out = 0;
+    for (auto offset : offsets) {
+        out += (uint64_t) offset * 32768 / size;
+    }
+    return out;
+}
+
+__attribute__((noinline)) uint32_t local_new(const std::vector<uint32_t>& offsets, const coordinate_scale_t& scale) {
+    uint32_t out = 0;
+    for (auto offset : offsets) {
+        out += local_coordinate(offset, scale);
+    }
+    return out;
+}
+
+template <typename F, typename T>
+double time_per_input(F&& f, const std::vector<T>& inputs, int rounds) {
+    volatile int64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        sink = sink + f(inputs);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds / inputs.size();
+}
+
+int main(int argc, char** argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+
+    std::mt19937 rng(1);
+    std::vector<input_t> old_inputs;
+    std::vector<input_t> new_inputs;
+    for (int i = 0; i < N; i++) {
+        int32_t value = (int32_t) (rng() % 41) - 20;
+        int32_t scaling = 125 * ((int32_t) (rng() % 33) - 16);
+        uint32_t sensitivity = rng() % 4001;
+        old_inputs.push_back({ value, scaling, sensitivity });
+        new_inputs.push_back({ value, scaling_to_fixed(scaling), sensitivity });
+    }
+
+    printf("1/1000   %5.2f ns/value\n", time_per_input(run_old, old_inputs, rounds));
+    printf("Q16.16   %5.2f ns/value\n", time_per_input(run_new, new_inputs, rounds));
+
+    const uint32_t SIZE = 16000000;
+    std::vector<uint32_t> offsets;
+    for (int i = 0; i < N; i++) {
+        offsets.push_back(rng() % SIZE);
+    }
+    coordinate_scale_t scale = coordinate_scale(SIZE);
+    printf("divide   %5.2f ns/coordinate\n", time_per_input([&](auto const& o) { return local_old(o, SIZE); }, offsets, rounds));
+    printf("scale    %5.2f ns/coordinate\n", time_per_input([&](auto const& o) { return local_new(o, scale); }, offsets, rounds));
+
+    return 0;
+}
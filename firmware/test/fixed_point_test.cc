@@ -0,0 +1,134 @@
+#include <random>
+
+#include "check.h"
+#include "fixed_point.h"
+
+// The Q16.16 arithmetic against the way it used to be done, in units of
+// 1/1000 (done here in 64 bits so that the old side never overflows).
+//
+// In range means: the scaling is a multiple of 125 (0.125) and no
+// accumulated sum gets to +-32768 whole units. Then every flushed value,
+// every carried remainder and every cursor step is bit-identical. Out of
+// range, scalings are off by at most half a Q16.16 step and sums saturate.
+//
+// The cursor's position on a screen is checked against the division it
+// replaced, for screens up to 2^30 units wide or high.
+
+const int64_t RANGE = 32768 * 1000;  // in 1/1000 units
+
+std::mt19937 rng(1);
+
+int32_t random_between(int32_t min, int32_t max) {
+    return std::uniform_int_distribution<int32_t>(min, max)(rng);
+}
+
+int64_t clamp(int64_t value) {
+    return std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, value));
+}
+
+void test_scaling_conversion() {
+    for (int32_t scaling = -(1 << 20); scaling <= (1 << 20); scaling++) {
+        int64_t error = (int64_t) scaling_to_fixed(scaling) * 1000 - (int64_t) scaling * FIXED_ONE;
+        CHECK((error == 0) == (scaling % 125 == 0));
+        CHECK((error >= -500) && (error <= 500));
+    }
+    CHECK(scaling_to_fixed(INT32_MAX) == INT32_MAX);
+    CHECK(scaling_to_fixed(INT32_MIN) == INT32_MIN);
+}
+
+void test_saturation() {
+    const int32_t edges[] = { INT32_MIN, INT32_MIN + 1, -65536, -1, 0, 1, 65536, INT32_MAX - 1, INT32_MAX };
+    for (int i = 0; i < 1000000; i++) {
+        int32_t a = (i % 10 < 9) ? (int32_t) rng() : edges[rng() % 9];
+        int32_t b = (i % 10 < 9) ? (int32_t) rng() >> (rng() % 32) : edges[rng() % 9];
+        CHECK(mul_saturating(a, b) == clamp((int64_t) a * b));
+        CHECK(add_saturating(a, b) == clamp((int64_t) a + b));
+    }
+}
+
+// A relative target: mapped values get added up and whole units go out in
+// reports, the rest is carried over.
+void test_accumulate_and_flush() {
+    for (int run = 0; run < 2000; run++) {
+        int32_t scaling = 125 * random_between(-80, 80);
+        int32_t fixed_scaling = scaling_to_fixed(scaling);
+        int32_t max_value = (rng() % 2) ? 3 : 3000;
+        int64_t old_acc = 0;
+        int32_t new_acc = 0;
+        for (int step = 0; step < 1000; step++) {
+            int32_t value = random_between(-max_value, max_value);
+            if (std::abs(old_acc + (int64_t) value * scaling) >= RANGE) {
+                value = 0;
+            }
+            old_acc += (int64_t) value * scaling;
+            new_acc = add_saturating(new_acc, mul_saturating(value, fixed_scaling));
+            CHECK((int64_t) new_acc * 1000 == old_acc * FIXED_ONE);
+
+            if (rng() % 4 == 0) {
+                int64_t old_out = old_acc / 1000;
+                old_acc -= old_out * 1000;
+                int32_t new_out = new_acc / FIXED_ONE;
+                new_acc -= new_out * FIXED_ONE;
+                CHECK(new_out == old_out);
+                CHECK((int64_t) new_acc * 1000 == old_acc * FIXED_ONE);
+            }
+        }
+    }
+}
+
+// Cursor movement: accumulated X/Y times the screen's sensitivity.
+void test_scale_movement() {
+    for (int i = 0; i < 10000000; i++) {
+        // anything that can come out of in-range scalings is a multiple of 125
+        int64_t old_acc = 125 * (int64_t) random_between(-RANGE / 125 + 1, RANGE / 125 - 1);
+        if (rng() % 4 == 0) {
+            old_acc = 125 * (int64_t) random_between(-100, 100);
+        }
+        uint32_t sensitivity = (rng() % 2) ? rng() % 4001 : rng() % (MAX_SENSITIVITY + 1);
+        int32_t new_acc = old_acc * FIXED_ONE / 1000;
+        CHECK(scale_movement(new_acc, sensitivity) == old_acc * sensitivity / 1000);
+    }
+    // and away from in range it's still the exact Q16.16 result, rounded towards zero
+    for (int i = 0; i < 10000000; i++) {
+        int32_t movement = rng();
+        uint32_t sensitivity = rng() % (MAX_SENSITIVITY + 1);
+        int64_t exact = (int64_t) movement * sensitivity;
+        int64_t expected = (exact < 0) ? -(-exact >> 16) : (exact >> 16);
+        if (expected == clamp(expected)) {
+            CHECK(scale_movement(movement, sensitivity) == expected);
+        }
+    }
+}
+
+// Screen offset to our 0..32767 absolute X/Y, against offset * 32768 / size.
+void test_local_coordinate() {
+    auto check = [](uint32_t size, uint32_t offset) {
+        CHECK(local_coordinate(offset, coordinate_scale(size)) == (uint64_t) offset * 32768 / size);
+    };
+    for (uint32_t size = 1; size <= 2048; size++) {
+        for (uint32_t offset = 0; offset < size; offset++) {
+            check(size, offset);
+        }
+    }
+    for (int i = 0; i < 1000000; i++) {
+        // half of them log-uniform, so that small screens get their share
+        uint32_t size = (i % 2) ? 1 + rng() % (1 << 30) : 1 + (rng() >> (2 + rng() % 30));
+        check(size, 0);
+        check(size, size - 1);
+        check(size, rng() % size);
+        // right at and around the boundaries between two output values
+        uint64_t boundary = ((uint64_t) (rng() % 32768) * size + 32767) / 32768;
+        for (uint64_t offset = (boundary > 0) ? boundary - 1 : 0; (offset <= boundary + 1) && (offset < size); offset++) {
+            check(size, offset);
+        }
+    }
+}
+
+int main() {
+    test_scaling_conversion();
+    test_saturation();
+    test_accumulate_and_flush();
+    test_scale_movement();
+    test_local_coordinate();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "bits.h"
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "our_descriptor.h"
+#include "our_descriptor_layout.h"
+#include "remapper.h"
+#include "serial.h"
+
+// The frames the remapper sends to forwarders: reports with scroll in them
+// marked as hi-res with the partial scroll timeout if the screen's forwarder
+// takes that, others (and all of them for other forwarders) as they are, and
+// a chain header in front of either for forwarders further down the chain.
+
+const uint16_t MOUSE = interface_of(1, 0);
+const uint16_t KEYBOARD = interface_of(2, 0);
+
+constexpr usage_def_t V_SCROLL = our_usage(V_SCROLL_USAGE).def;
+constexpr usage_def_t KEY_A = our_usage(0x00070004).def;
+
+// the frames sent to the forwarders for one mouse and one keyboard report
+std::vector<sent_t> frames_for(int8_t screen) {
+    active_screen = screen;
+    cursor_x = screens[screen].x + 10;
+    cursor_y = screens[screen].y + 10;
+    host_sent.clear();
+    mouse_report_t mouse = { .buttons = 1, .wheel = 1 };
+    keyboard_report_t kbd = { .keys = { 0x04 } };
+    receive(MOUSE, mouse);
+    receive(KEYBOARD, kbd);
+    for (int i = 0; i < 16; i++) {
+        host_loop();
+        host_time_us += 250;
+    }
+    mouse = {};
+    kbd = {};
+    receive(MOUSE, mouse);
+    receive(KEYBOARD, kbd);
+    for (int i = 0; i < 16; i++) {
+        host_loop();
+        host_time_us += 250;
+    }
+    std::vector<sent_t> frames;
+    for (auto const& sent : host_sent) {
+        CHECK(sent.uart == 1);
+        frames.push_back(sent);
+    }
+    return frames;
+}
+
+int main() {
+    // 1 and 2 take hi-res scroll, 3 doesn't
+    screen_count = 4;
+    for (int8_t i = 0; i < 4; i++) {
+        screens[i] = {
+            .x = (uint32_t) i * 1000000,
+            .y = 0,
+            .w = 1000000,
+            .h = 800000,
+            .sensitivity = 1000,
+            .route = i ? ScreenRoute::FORWARDER : ScreenRoute::LOCAL_USB,
+            .forwarder_address = (uint8_t) ((i == 2) ? 2 : 0),
+            .flags = (uint8_t) (((i == 1) || (i == 2)) ? SCREEN_FLAG_HIRES_FORWARDER : 0),
+        };
+    }
+    partial_scroll_timeout = 300001;  // rounded up to milliseconds
+    host_init();
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    host_loop();
+
+    for (int8_t screen : { 1, 2, 3 }) {
+        std::vector<uint8_t> chain_header;
+        if (screen == 2) {
+            chain_header = { FORWARDER_CHAIN_MARKER, 2 };
+        }
+        std::vector<sent_t> frames = frames_for(screen);
+        bool scrolled = false;
+        bool typed = false;
+        for (auto const& frame : frames) {
+            const uint8_t* data = frame.data.data() + chain_header.size();
+            CHECK(std::equal(chain_header.begin(), chain_header.end(), frame.data.begin()));
+            if (data[0] == FORWARDER_HIRES_MARKER) {
+                CHECK(screen != 3);
+                CHECK((data[1] | (data[2] << 8)) == 301);
+                CHECK(data[3] == REPORT_ID_MOUSE);
+                CHECK(frame.data.size() == chain_header.size() + 4 + OUR_LAYOUT.report_sizes[REPORT_ID_MOUSE]);
+                if (get_bits(data + 4, OUR_LAYOUT.report_sizes[REPORT_ID_MOUSE], V_SCROLL.bitpos, V_SCROLL.size) == RESOLUTION_MULTIPLIER) {
+                    scrolled = true;
+                }
+            } else if ((screen == 3) && (data[0] == REPORT_ID_MOUSE)) {
+                CHECK(frame.data.size() == 1 + OUR_LAYOUT.report_sizes[REPORT_ID_MOUSE]);
+                if (get_bits(data + 1, OUR_LAYOUT.report_sizes[REPORT_ID_MOUSE], V_SCROLL.bitpos, V_SCROLL.size) == 1) {
+                    scrolled = true;
+                }
+            } else {
+                CHECK(data[0] == REPORT_ID_KEYBOARD);
+                CHECK(frame.data.size() == chain_header.size() + 1 + OUR_LAYOUT.report_sizes[REPORT_ID_KEYBOARD]);
+                if (get_bits(data + 1, OUR_LAYOUT.report_sizes[REPORT_ID_KEYBOARD], KEY_A.bitpos, KEY_A.size)) {
+                    typed = true;
+                }
+            }
+        }
+        CHECK(scrolled);
+        CHECK(typed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <vector>
+
+#include "bits.h"
+#include "host.h"
+#include "our_descriptor.h"
+#include "our_descriptor_layout.h"
+#include "serial.h"
+
+// What a forwarder makes of the frames it gets: hi-res scroll turned into
+// clicks if its host didn't enable hi-res, the remainder dropped after the
+// timeout from the frame, wheel clicks passed on as they are unless the host
+// did enable hi-res and chained frames passed on down the chain.
+
+// forwarder.cc
+void serial_callback(const uint8_t* data, uint16_t len);
+void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize);
+void tud_mount_cb();
+
+// forwarder_main() isn't called
+bool serial_read(msg_recv_cb_t callback, uart_inst_t* uart) {
+    return false;
+}
+
+constexpr usage_def_t V_SCROLL = our_usage(V_SCROLL_USAGE).def;
+constexpr usage_def_t BUTTON_1 = our_usage(0x00090001).def;
+const uint16_t MOUSE_REPORT_SIZE = OUR_LAYOUT.report_sizes[REPORT_ID_MOUSE];
+static_assert(V_SCROLL.report_id == REPORT_ID_MOUSE);
+
+std::vector<uint8_t> mouse_report(int32_t scroll, bool button = false) {
+    std::vector<uint8_t> report(MOUSE_REPORT_SIZE);
+    put_bits(report.data(), report.size(), V_SCROLL.bitpos, V_SCROLL.size, scroll);
+    put_bits(report.data(), report.size(), BUTTON_1.bitpos, BUTTON_1.size, button);
+    return report;
+}
+
+int32_t scroll_of(const sent_t& sent) {
+    CHECK((sent.uart == -1) && (sent.report_id == REPORT_ID_MOUSE));
+    int32_t value = get_bits(sent.data.data(), sent.data.size(), V_SCROLL.bitpos, V_SCROLL.size);
+    if (value & (1 << (V_SCROLL.size - 1))) {
+        value |= 0xFFFFFFFF << V_SCROLL.size;
+    }
+    return value;
+}
+
+void send_frame(std::vector<uint8_t> frame) {
+    host_sent.clear();
+    serial_callback(frame.data(), frame.size());
+}
+
+std::vector<uint8_t> hires_frame(uint16_t timeout_ms, int32_t scroll, bool button = false) {
+    std::vector<uint8_t> frame = { FORWARDER_HIRES_MARKER, (uint8_t) (timeout_ms & 0xFF), (uint8_t) (timeout_ms >> 8), REPORT_ID_MOUSE };
+    std::vector<uint8_t> report = mouse_report(scroll, button);
+    frame.insert(frame.end(), report.begin(), report.end());
+    return frame;
+}
+
+// sends hi-res scroll, returns the clicks that came out
+int32_t scroll(int32_t value, uint16_t timeout_ms = 1000) {
+    send_frame(hires_frame(timeout_ms, value));
+    CHECK(host_sent.size() == 1);
+    return scroll_of(host_sent[0]);
+}
+
+int main() {
+    tud_mount_cb();
+
+    // without the marker it's wheel clicks
+    std::vector<uint8_t> lores_frame = { REPORT_ID_MOUSE };
+    std::vector<uint8_t> report = mouse_report(-3, true);
+    lores_frame.insert(lores_frame.end(), report.begin(), report.end());
+    send_frame(lores_frame);
+    CHECK(host_sent.size() == 1);
+    CHECK(host_sent[0].data == report);
+
+    // hi-res to clicks, the rest carries over
+    CHECK(scroll(60) == 0);
+    CHECK(scroll(60) == 1);
+    CHECK(scroll(250) == 2);
+    CHECK(scroll(-20) == 0);  // the other way, the 10 left over are dropped
+    CHECK(scroll(-100) == -1);
+
+    // what's left is dropped when scrolling stopped for longer than the timeout
+    host_time_us += 1000000;
+    CHECK(scroll(100) == 0);
+    host_time_us += 50000;
+    CHECK(scroll(100, 50) == 1);
+    host_time_us += 50001;
+    CHECK(scroll(100, 50) == 0);
+    host_time_us += 49000;
+    CHECK(scroll(20, 50) == 1);
+
+    // the rest of the report is left alone
+    send_frame(hires_frame(1000, 0, true));
+    CHECK(host_sent.size() == 1);
+    CHECK(host_sent[0].data == mouse_report(0, true));
+
+    // the host enabled hi-res, it gets it as it is
+    uint8_t multiplier = V_RESOLUTION_BITMASK | H_RESOLUTION_BITMASK;
+    tud_hid_set_report_cb(0, REPORT_ID_MULTIPLIER, HID_REPORT_TYPE_FEATURE, &multiplier, 1);
+    CHECK(scroll(60) == 60);
+    CHECK(scroll(-7) == -7);
+    send_frame(lores_frame);
+    CHECK(host_sent.size() == 1);
+    CHECK(host_sent[0].data == mouse_report(-3 * RESOLUTION_MULTIPLIER, true));
+    lores_frame = { REPORT_ID_MOUSE };
+    report = mouse_report(1000);
+    lores_frame.insert(lores_frame.end(), report.begin(), report.end());
+    send_frame(lores_frame);
+    CHECK(scroll_of(host_sent[0]) == 32767);
+
+    // down the chain, the address goes down by one and the header goes away at 1
+    std::vector<uint8_t> frame = hires_frame(1000, 60);
+    std::vector<uint8_t> chained = { FORWARDER_CHAIN_MARKER, 3 };
+    chained.insert(chained.end(), frame.begin(), frame.end());
+    send_frame(chained);
+    CHECK(host_sent.size() == 1);
+    chained[1] = 2;
+    CHECK(host_sent[0] == (sent_t{ 1, 0, chained }));
+    chained[1] = 1;
+    send_frame(chained);
+    CHECK(host_sent.size() == 1);
+    CHECK(host_sent[0] == (sent_t{ 1, 0, frame }));
+
+    // too short to be anything
+    send_frame({ FORWARDER_HIRES_MARKER, 0, 0 });
+    CHECK(host_sent.empty());
+
+    return 0;
+}
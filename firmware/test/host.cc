@@ -0,0 +1,27 @@
+#include "host.h"
+
+uint64_t host_time_us = 0;
+uart_inst_t host_uarts[2] = { { 0 }, { 1 } };
+
+bool host_ready = true;
+bool host_capture = true;
+std::vector<sent_t> host_sent;
+std::deque<received_t> host_received;
+
+bool tud_hid_report(uint8_t report_id, const void* report, uint16_t len) {
+    if (host_capture) {
+        host_sent.push_back({ -1, report_id, std::vector<uint8_t>((const uint8_t*) report, (const uint8_t*) report + len) });
+    }
+    return true;
+}
+
+bool tud_hid_ready() {
+    return host_ready;
+}
+
+// serial.cc isn't built for the host, frames are captured instead of sent
+void serial_write(const uint8_t* data, uint16_t len, uart_inst_t* uart) {
+    if (host_capture) {
+        host_sent.push_back({ (int8_t) uart->index, 0, std::vector<uint8_t>(data, data + len) });
+    }
+}
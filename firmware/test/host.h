@@ -0,0 +1,58 @@
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <vector>
+
+#include "check.h"
+#include "host_sdk.h"
+
+// What went out: reports on our USB port and frames on the forwarder UART.
+struct sent_t {
+    int8_t uart;        // -1 for USB
+    uint8_t report_id;  // USB only, it's in the frame for the UART
+    std::vector<uint8_t> data;
+
+    bool operator==(const sent_t& other) const {
+        return (uart == other.uart) && (report_id == other.report_id) && (data == other.data);
+    }
+};
+
+struct received_t {
+    uint16_t interface;  // dev_addr << 8 | interface
+    std::vector<uint8_t> report;
+};
+
+extern bool host_ready;               // what tud_hid_ready() says
+extern bool host_capture;             // benchmarks turn it off
+extern std::vector<sent_t> host_sent;
+extern std::deque<received_t> host_received;  // read_report() takes them from here
+extern bool host_full_scan;  // evaluate every mapping on every pass, not just what changed
+
+// The firmware's main loop minus the config: takes one report from
+// host_received (if there is one) and handles a start-of-frame tick if one is
+// due every 1000 us of host_time_us.
+void host_loop();
+
+// What the firmware does before its main loop, with whatever the test put in
+// screens, config_mappings etc. The descriptor parser prints every item it
+// sees, so stdout goes to /dev/null, what the test itself has to say goes to
+// the stream this returns.
+FILE* host_init();
+
+// remapper.cc
+void parse_our_descriptor();
+void update_their_descriptor_derivates();
+void process_mapping(bool auto_repeat);
+void send_report();
+int8_t find_screen(int32_t x, int32_t y);
+void move_cursor(int32_t x, int32_t y);
+extern volatile bool tick_pending;
+extern int32_t cursor_x;
+extern int32_t cursor_y;
+extern int8_t active_screen;
+
+#endif
@@ -0,0 +1,104 @@
+
+#include <atomic>
+#include <thread>
+
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "our_descriptor_layout.h"
+#include "remapper.h"
+
+// In the single build, descriptors are parsed and cleared on the PIO USB core
+// while the other core handles reports. Here a second thread plugs and
+// unplugs a mouse and a composite device as fast as it can while the main
+// thread streams keyboard and mouse reports through the main loop. The
+// keyboard stays plugged in the whole time and none of its reports may get
+// lost. Nothing on the report path may take a mutex, the main loop may never
+// wait for one (updates that can't get it have to be put off), and once the
+// plugging stops the mouse has to work.
+
+const uint16_t KEYBOARD = interface_of(2, 0);
+const uint16_t MOUSE = interface_of(3, 0);
+const uint16_t COMPOSITE = interface_of(4, 1);
+
+const int CYCLES = 2000;
+
+std::atomic<bool> done(false);
+
+void hotplug() {
+    for (int i = 0; i < CYCLES; i++) {
+        parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+        if (i % 3 == 0) {
+            parse_descriptor(0x1234, 0x0003, COMPOSITE_DESCRIPTOR, sizeof(COMPOSITE_DESCRIPTOR), COMPOSITE);
+        }
+        std::this_thread::yield();
+        clear_descriptor_data(MOUSE >> 8);
+        if (i % 3 == 1) {
+            clear_descriptor_data(COMPOSITE >> 8);
+        }
+    }
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+    done = true;
+}
+
+template <typename T>
+bool handle(uint16_t interface, const T& report) {
+    return handle_received_report((const uint8_t*) &report, sizeof(report), interface);
+}
+
+void update_if_needed() {
+    if (their_descriptor_updated) {
+        their_descriptor_updated = false;
+        update_their_descriptor_derivates();
+    }
+}
+
+int main() {
+    host_capture = false;
+    FILE* out = host_init();
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    update_if_needed();
+
+    keyboard_report_t kbd = {};
+    mouse_report_t mouse = {};
+    uint32_t passes = 0;
+    uint32_t mutex_waits = host_mutex_waits;
+    std::thread plugger(hotplug);
+    while (!done) {
+        uint32_t mutex_entries = host_mutex_entries;
+        kbd.keys[0] = 0x04 + passes % 26;  // never the same report twice in a row
+        CHECK(handle(KEYBOARD, kbd));
+        mouse.x = (passes % 2) ? 1 : -1;  // back and forth, staying on the same screen
+        handle(MOUSE, mouse);
+        process_mapping(true);
+        send_report();
+        CHECK(host_mutex_entries == mutex_entries);
+        update_if_needed();
+        passes++;
+    }
+    plugger.join();
+    update_if_needed();
+    CHECK(!their_descriptor_updated);
+    CHECK(host_mutex_waits == mutex_waits);
+    fprintf(out, "%u passes while plugging and unplugging\n", passes);
+
+    host_capture = true;
+    mouse.buttons = 1;
+    CHECK(handle(MOUSE, mouse));
+    process_mapping(true);
+    for (int i = 0; i < 16; i++) {  // whatever is still queued goes first
+        send_report();
+    }
+    constexpr our_usage_t BUTTON_1 = our_usage(0x00090001);
+    bool clicked = false;
+    for (auto const& sent : host_sent) {
+        if ((sent.uart == -1) && (sent.report_id == BUTTON_1.def.report_id) &&
+            get_bits(sent.data.data(), sent.data.size(), BUTTON_1.def.bitpos, BUTTON_1.def.size)) {
+            clicked = true;
+        }
+    }
+    CHECK(clicked);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <chrono>
+
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "remapper.h"
+
+// Time per millisecond tick (decoding, mapping and queueing a mouse report and
+// a keyboard report, or just the mouse report) against the number of mappings.
+
+const uint16_t MOUSE = interface_of(1, 0);
+const uint16_t KEYBOARD = interface_of(2, 0);
+
+void make_mappings(int n) {
+    config_mappings.clear();
+    for (int i = 0; i < n; i++) {
+        uint32_t source = 0x00070004 + (i % 98);
+        uint32_t target = 0x00070004 + ((i * 37) % 98);
+        switch (i % 8) {
+            case 0:
+                target = 0x00010030 + (i / 8) % 2;  // key to cursor movement, runs every tick
+                break;
+            case 1:
+                source = (i / 8) % 2 ? 0x00010031 : 0x00010030;  // mouse movement to key
+                break;
+            case 2:
+                source = 0x00090001 + (i / 8) % 5;
+                break;
+        }
+        config_mappings.push_back({ .target_usage = target, .source_usage = source, .scaling = 1000, .layer = (uint8_t) ((i % 16 == 15) ? 1 : 0), .flags = 0 });
+    }
+    config_mappings.push_back({ .target_usage = 0xFFF10001, .source_usage = 0x00070039 });  // caps lock -> layer 1
+    config_mappings.push_back({ .target_usage = 0x00010030, .source_usage = 0x00010030, .scaling = 1000 });
+    config_mappings.push_back({ .target_usage = 0x00010031, .source_usage = 0x00010031, .scaling = 1000 });
+    set_mapping_from_config();
+}
+
+// Keys held by ten fingers that move every now and then, a mouse that never stops.
+double run(int ticks, bool keyboard) {
+    mouse_report_t mouse = {};
+    keyboard_report_t kbd = {};
+    uint32_t rng = 1;
+    auto next = [&rng]() {
+        rng = rng * 1664525 + 1013904223;
+        return rng >> 16;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        mouse.x = (int16_t) (next() % 21) - 10;
+        mouse.y = (int16_t) (next() % 21) - 10;
+        if (next() % 64 == 0) {
+            mouse.buttons ^= 1;
+        }
+        receive(MOUSE, mouse);
+        if (keyboard) {
+            kbd.keys[next() % 6] = (next() % 3) ? 0x04 + next() % 98 : 0;
+            receive(KEYBOARD, kbd);
+        }
+        while (!host_received.empty()) {
+            host_loop();
+        }
+        host_loop();
+        host_time_us += 1000;
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char** argv) {
+    int ticks = (argc > 1) ? atoi(argv[1]) : 20000;
+
+    host_capture = false;
+    unmapped_passthrough = false;
+    FILE* out = host_init();
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    update_their_descriptor_derivates();
+    their_descriptor_updated = false;
+
+    // with the keyboard idle only the mappings with mouse sources and the
+    // ones that run every tick (about 3/8 of them) get evaluated
+    fprintf(out, "mappings  ns/tick  ns/tick (idle keyboard)\n");
+    for (int n : { 0, 16, 64, 256, 1024 }) {
+        make_mappings(n);
+        run(ticks / 10, true);  // warm up
+        double both = run(ticks, true);
+        double mouse_only = run(ticks, false);
+        fprintf(out, "%8d  %7.0f  %7.0f\n", n, both, mouse_only);
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "remapper.h"
+
+// Replays random keyboard, mouse and composite device input with a number of
+// configs, once the way the firmware does it (only mappings whose sources
+// changed are evaluated) and once evaluating every mapping on every pass.
+// What goes out has to be the same, report for report.
+//
+// Each replay runs in a child process so that it starts from a fresh remapper.
+
+const uint16_t MOUSE = interface_of(1, 0);
+const uint16_t KEYBOARD = interface_of(2, 0);
+const uint16_t COMPOSITE = interface_of(3, 1);
+
+enum class Host {
+    READY,       // the endpoint is always ready
+    SOMETIMES,   // two times out of three
+    SLOW,        // every eighth pass, the queues fill up
+};
+
+void add_mapping(uint32_t target, uint32_t source, int32_t scaling = 1000, uint8_t layer = 0, uint8_t flags = 0) {
+    config_mappings.push_back({ .target_usage = target, .source_usage = source, .scaling = scaling, .layer = layer, .flags = flags });
+}
+
+void set_config(int config) {
+    config_mappings.clear();
+    unmapped_passthrough = true;
+    switch (config) {
+        case 0:  // passthrough only
+            break;
+        case 1:
+            add_mapping(0x00010030, 0x00010030, 1500);
+            add_mapping(0x00010031, 0x00010031, -700);
+            add_mapping(0x00090001, 0x00070004);       // A -> left button
+            add_mapping(0x000700E1, 0x00090002);       // right button -> shift
+            add_mapping(0x00010038, 0x00070005, 250);  // B -> wheel, every tick
+            add_mapping(0x000C0238, 0x00010038, 333);  // wheel -> pan
+            add_mapping(0x00070006, 0x00010030);       // mouse X -> C
+            break;
+        case 2:
+            add_mapping(0xFFF10001, 0x00070039);                // caps lock -> layer 1
+            add_mapping(0xFFF10002, 0x000700E0, 1000, 0, 1);    // left ctrl -> layer 2, sticky
+            add_mapping(0x00070050, 0x0007000B, 1000, 1);       // layer 1: H -> left arrow
+            add_mapping(0x00090001, 0x0007000D, 1000, 2);       // layer 2: J -> left button
+            add_mapping(0x00070004, 0x00070007, 1000, 0, 1);    // D -> A, sticky
+            add_mapping(0x00070005, 0x00070007, 1000, 1, 1);    // layer 1: D -> B, sticky
+            add_mapping(0xFFF20001, 0x00090003);                // middle button -> switch screen
+            add_mapping(0xFFF20001, 0x00070029, 1000, 1);       // layer 1: escape -> switch screen
+            add_mapping(0x00010030, 0x0007000E, 3000, 0, 1);    // K -> cursor right, sticky
+            break;
+        case 3:
+            unmapped_passthrough = false;
+            add_mapping(0x00010030, 0x00010031, 2000);
+            add_mapping(0x00010031, 0x00010030, 2000);
+            add_mapping(0x00010038, 0x00010038);
+            add_mapping(0x00010038, 0x000C0238, -1000);
+            add_mapping(0x00090002, 0x00090001);
+            add_mapping(0x00090001, 0x00090002);
+            add_mapping(0x00070008, 0x000C00E9);  // volume up -> E
+            break;
+    }
+}
+
+std::string replay(int config, uint32_t seed, Host host, bool full_scan) {
+    std::mt19937 rng(seed);
+
+    host_full_scan = full_scan;
+    screen_count = 3;
+    for (int8_t i = 0; i < 3; i++) {
+        screens[i] = {
+            .x = (uint32_t) i * 1000000,
+            .y = (i == 2) ? 300000u : 0,
+            .w = 1000000,
+            .h = 800000,
+            .sensitivity = 2500,
+            .route = i ? ScreenRoute::FORWARDER : ScreenRoute::LOCAL_USB,
+            .forwarder_address = (uint8_t) (i ? i - 1 : 0),
+        };
+    }
+    constraint_mode = (ConstraintMode) (seed % 3);
+    resolution_multiplier = (seed & 4) ? 0x05 : 0;
+    partial_scroll_timeout = 50000;
+    set_config(config);
+    host_init();
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    parse_descriptor(0x1234, 0x0003, COMPOSITE_DESCRIPTOR, sizeof(COMPOSITE_DESCRIPTOR), COMPOSITE);
+
+    mouse_report_t mouse = {};
+    keyboard_report_t kbd = {};
+    const uint8_t keys[] = { 0x04, 0x05, 0x06, 0x07, 0x0B, 0x0D, 0x0E, 0x29, 0x39 };
+    for (int step = 0; step < 4000; step++) {
+        switch (rng() % 10) {
+            case 0:
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+                mouse.x = (int16_t) (rng() % 41) - 20;
+                mouse.y = (int16_t) (rng() % 41) - 20;
+                if (rng() % 7 == 0) {
+                    mouse.x *= 30;
+                }
+                if (rng() % 5 == 0) {
+                    mouse.buttons ^= 1 << (rng() % 5);
+                }
+                mouse.wheel = (rng() % 4 == 0) ? (int8_t) (rng() % 5) - 2 : 0;
+                mouse.pan = (rng() % 8 == 0) ? (int8_t) (rng() % 5) - 2 : 0;
+                receive(MOUSE, mouse);
+                break;
+            case 5:
+            case 6:
+                if (rng() % 2) {
+                    kbd.modifiers ^= 1 << (rng() % 8);
+                }
+                kbd.keys[rng() % 6] = (rng() % 2) ? keys[rng() % sizeof(keys)] : 0;
+                receive(KEYBOARD, kbd);
+                break;
+            case 7: {
+                uint8_t report_id = 1 + rng() % 3;
+                uint8_t report[5] = { report_id };
+                for (int i = 1; i < 5; i++) {
+                    report[i] = (report_id == 1) ? 0x04 + rng() % 10 : rng() % 256;
+                }
+                if ((report_id == 3) && (rng() % 2)) {
+                    report[1] = 0xE9;
+                    report[2] = 0;
+                }
+                if (rng() % 3 == 0) {
+                    report[1] = 0;
+                }
+                host_received.push_back({ COMPOSITE, std::vector<uint8_t>(report, report + ((report_id == 2) ? 2 : 5)) });
+                break;
+            }
+        }
+        switch (host) {
+            case Host::READY:
+                host_ready = true;
+                break;
+            case Host::SOMETIMES:
+                host_ready = (rng() % 3) != 0;
+                break;
+            case Host::SLOW:
+                host_ready = (step % 8) == 0;
+                break;
+        }
+        host_loop();
+        host_time_us += 250;
+    }
+    host_ready = true;
+    for (int i = 0; i < 64; i++) {
+        host_loop();
+        host_time_us += 250;
+    }
+
+    std::string trace;
+    for (auto const& sent : host_sent) {
+        trace += std::to_string(sent.uart) + " " + std::to_string(sent.report_id) + ":";
+        for (auto b : sent.data) {
+            trace += " " + std::to_string(b);
+        }
+        trace += "\n";
+    }
+    trace += "cursor " + std::to_string(cursor_x) + " " + std::to_string(cursor_y) + " " + std::to_string(active_screen) + "\n";
+    return trace;
+}
+
+std::string replay_in_child(int config, uint32_t seed, Host host, bool full_scan) {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    fflush(stdout);
+    pid_t pid = fork();
+    CHECK(pid != -1);
+    if (pid == 0) {
+        close(fds[0]);
+        std::string trace = replay(config, seed, host, full_scan);
+        for (size_t done = 0; done < trace.size();) {
+            ssize_t written = write(fds[1], trace.data() + done, trace.size() - done);
+            CHECK(written > 0);
+            done += written;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    std::string trace;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        trace.append(buf, n);
+    }
+    close(fds[0]);
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    return trace;
+}
+
+int main() {
+    long reports = 0;
+    for (int config = 0; config < 4; config++) {
+        for (Host host : { Host::READY, Host::SOMETIMES, Host::SLOW }) {
+            for (uint32_t seed = 1; seed <= 8; seed++) {
+                std::string changed_only = replay_in_child(config, seed, host, false);
+                std::string full_scan = replay_in_child(config, seed, host, true);
+                if (changed_only != full_scan) {
+                    size_t i = std::mismatch(changed_only.begin(), changed_only.end(), full_scan.begin()).first - changed_only.begin();
+                    size_t line = std::count(changed_only.begin(), changed_only.begin() + i, '\n');
+                    fprintf(stderr, "config %d, host %d, seed %u: differs at line %zu\n", config, (int) host, seed, line + 1);
+                }
+                CHECK(changed_only == full_scan);
+                reports += std::count(changed_only.begin(), changed_only.end(), '\n') - 1;
+            }
+        }
+    }
+    printf("%ld reports, no differences\n", reports);
+    return 0;
+}
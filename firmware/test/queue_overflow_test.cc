@@ -0,0 +1,109 @@
+#include "bits.h"
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "our_descriptor.h"
+#include "our_descriptor_layout.h"
+#include "remapper.h"
+
+// A keyboard and a mouse press and release a key and a button every
+// millisecond while the host takes one report per millisecond, so button and
+// key changes pile up in the queue. Like the PIO USB endpoints, each device
+// only keeps its latest report: one that comes in before the last one was
+// read replaces it.
+//
+// As long as the changes fit in the queue, every press and every release has
+// to reach the host, in the order they came in. When they don't, input still
+// has to be read as it comes in and the host has to end up with everything
+// released.
+
+const uint16_t MOUSE = interface_of(1, 0);
+const uint16_t KEYBOARD = interface_of(2, 0);
+
+constexpr usage_def_t KEY_A = our_usage(0x00070004).def;
+constexpr usage_def_t BUTTON_1 = our_usage(0x00090001).def;
+
+int overwritten = 0;
+
+template <typename T>
+void device_report(uint16_t interface, const T& report) {
+    for (auto it = host_received.begin(); it != host_received.end(); it++) {
+        if (it->interface == interface) {
+            host_received.erase(it);
+            overwritten++;
+            break;
+        }
+    }
+    receive(interface, report);
+}
+
+// Key and button changes the host saw, in order, after toggling both n times.
+std::vector<char> toggle(int n) {
+    host_sent.clear();
+    for (int ms = 0; ms < n + 1000; ms++) {
+        if (ms < n) {
+            keyboard_report_t kbd = {};
+            kbd.keys[0] = (ms % 2) ? 0 : 0x04;
+            device_report(KEYBOARD, kbd);
+            mouse_report_t mouse = {};
+            mouse.buttons = (ms % 2) ? 0 : 1;
+            mouse.x = (ms % 2) ? 1 : -1;
+            device_report(MOUSE, mouse);
+        }
+        host_ready = true;
+        for (int pass = 0; pass < 8; pass++) {
+            size_t sent = host_sent.size();
+            host_loop();
+            if (host_sent.size() > sent) {
+                host_ready = false;
+            }
+            host_time_us += 125;
+        }
+    }
+
+    std::vector<char> transitions;
+    bool key_a = false;
+    bool button_1 = false;
+    for (auto const& sent : host_sent) {
+        CHECK(sent.uart == -1);
+        if (sent.report_id == KEY_A.report_id) {
+            bool pressed = get_bits(sent.data.data(), sent.data.size(), KEY_A.bitpos, KEY_A.size);
+            if (pressed != key_a) {
+                transitions.push_back('k');
+                key_a = pressed;
+            }
+        }
+        if (sent.report_id == BUTTON_1.report_id) {
+            bool pressed = get_bits(sent.data.data(), sent.data.size(), BUTTON_1.bitpos, BUTTON_1.size);
+            if (pressed != button_1) {
+                transitions.push_back('m');
+                button_1 = pressed;
+            }
+        }
+    }
+    CHECK(!key_a && !button_1);
+    return transitions;
+}
+
+int main() {
+    host_init();
+    parse_descriptor(0x1234, 0x0001, MOUSE_DESCRIPTOR, sizeof(MOUSE_DESCRIPTOR), MOUSE);
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    host_loop();
+
+    // two changes come in per millisecond and one goes out, this leaves 24 queued
+    std::vector<char> transitions = toggle(24);
+    CHECK(transitions.size() == 2 * 24);
+    for (size_t i = 0; i < transitions.size(); i++) {
+        CHECK(transitions[i] == ((i % 2) ? 'm' : 'k'));
+    }
+    CHECK(overwritten == 0);
+
+    // and this doesn't fit
+    transitions = toggle(400);
+    CHECK(transitions.size() < 2 * 400);
+    CHECK(overwritten == 0);
+
+    return 0;
+}
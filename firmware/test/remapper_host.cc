@@ -0,0 +1,88 @@
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "descriptor_parser.h"
+#include "globals.h"
+#include "host.h"
+#include "remapper.h"
+
+// What the board specific files (remapper_single.cc etc.) and config.cc
+// provide in the firmware.
+
+void extra_init() {
+}
+
+bool read_report() {
+    if (host_received.empty()) {
+        return false;
+    }
+    received_t received = host_received.front();
+    host_received.pop_front();
+    return handle_received_report(received.report.data(), received.report.size(), received.interface);
+}
+
+void interval_override_updated() {
+}
+
+void load_config() {
+}
+
+void persist_config() {
+}
+
+bool host_full_scan = false;
+uint64_t host_next_tick = 0;
+
+// remapper.cc
+extern std::vector<uint32_t> dirty_slots;
+extern bool evaluate_all_targets;
+
+void run_mapping(bool auto_repeat) {
+    if (host_full_scan) {
+        std::fill(dirty_slots.begin(), dirty_slots.end(), 0xFFFFFFFF);
+        evaluate_all_targets = true;
+    }
+    process_mapping(auto_repeat);
+}
+
+bool get_tick() {
+    bool tick = tick_pending;
+    tick_pending = false;
+    return tick;
+}
+
+FILE* host_init() {
+    fflush(stdout);
+    FILE* out = fdopen(dup(fileno(stdout)), "w");
+    CHECK(out != NULL);
+    setvbuf(out, NULL, _IOLBF, 0);
+    CHECK(freopen("/dev/null", "w", stdout) != NULL);
+
+    parse_our_descriptor();
+    report_priority_updated();
+    screens_updated();
+    set_mapping_from_config();
+    return out;
+}
+
+void host_loop() {
+    if (host_time_us >= host_next_tick) {
+        tick_pending = true;
+        host_next_tick = host_time_us - host_time_us % 1000 + 1000;
+    }
+    if (read_report()) {
+        run_mapping(get_tick());
+    }
+    if (tud_hid_ready()) {
+        if (get_tick()) {
+            run_mapping(true);
+        }
+        send_report();
+    }
+    if (their_descriptor_updated) {
+        // cleared first so that a change on the other core while we're at it isn't lost
+        their_descriptor_updated = false;
+        update_their_descriptor_derivates();
+    }
+}
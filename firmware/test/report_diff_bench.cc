@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "bits.h"
+#include "globals.h"
+#include "host.h"
+#include "our_descriptor.h"
+#include "our_descriptor_layout.h"
+
+// Time per call of what runs for every report that goes out: whether it has to
+// be sent at all (needs_to_be_sent()), whether it changes buttons or keys
+// (is_edge()), adding up relative fields (aggregate_relative()) and merging it
+// into a queued report (merge_into()). The checks go through the whole report,
+// nothing in it changed. For comparison, the checks the way they were done
+// before, a byte at a time.
+
+struct outgoing_queue_t;
+
+// remapper.cc
+extern uint32_t reports[MAX_INPUT_REPORT_ID + 1][OUR_REPORT_WORDS];
+extern uint32_t* prev_reports[MAX_INPUT_REPORT_ID + 1];
+extern outgoing_queue_t motion_queue;
+bool needs_to_be_sent(uint8_t report_id);
+bool is_edge(uint8_t report_id);
+bool aggregate_relative(uint8_t* prev_report, const uint8_t* report, uint8_t report_id);
+bool merge_into(outgoing_queue_t& queue, int8_t idx, const uint32_t* report, uint8_t report_id, const uint32_t* changes);
+bool queue_report(uint8_t report_id, bool include_motion);
+int8_t newest_queued(const outgoing_queue_t& queue, uint8_t report_id);
+
+constexpr usage_def_t MOUSE_X = our_usage(0x00010030).def;
+constexpr usage_def_t MOUSE_Y = our_usage(0x00010031).def;
+
+constexpr our_masks_t make_edge_masks() {
+    our_masks_t masks = OUR_LAYOUT.masks_absolute;
+    masks.clear(MOUSE_X.report_id, MOUSE_X.bitpos, MOUSE_X.size);
+    masks.clear(MOUSE_Y.report_id, MOUSE_Y.bitpos, MOUSE_Y.size);
+    return masks;
+}
+
+constexpr our_masks_t EDGE_MASKS = make_edge_masks();
+
+bool needs_to_be_sent_bytewise(uint8_t report_id) {
+    const uint8_t* report = (const uint8_t*) reports[report_id];
+    const uint8_t* prev_report = (const uint8_t*) prev_reports[report_id];
+    const uint8_t* relative = (const uint8_t*) OUR_LAYOUT.masks_relative[report_id];
+    const uint8_t* absolute = (const uint8_t*) OUR_LAYOUT.masks_absolute[report_id];
+
+    for (int i = 0; i < OUR_LAYOUT.report_sizes[report_id]; i++) {
+        if ((report[i] & relative[i]) || ((report[i] ^ prev_report[i]) & absolute[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool is_edge_bytewise(uint8_t report_id) {
+    const uint8_t* report = (const uint8_t*) reports[report_id];
+    const uint8_t* prev_report = (const uint8_t*) prev_reports[report_id];
+    const uint8_t* edge = (const uint8_t*) EDGE_MASKS[report_id];
+
+    for (int i = 0; i < OUR_LAYOUT.report_sizes[report_id]; i++) {
+        if ((report[i] ^ prev_report[i]) & edge[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename F>
+double time_per_call(F&& f, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        f(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+}
+
+// One report with the cursor moving right and one with it moving back, so
+// that adding them up never runs out of room.
+void make_moves(uint32_t* right, uint32_t* left) {
+    uint16_t size = OUR_LAYOUT.report_sizes[REPORT_ID_MOUSE];
+    memset(right, 0, OUR_REPORT_WORDS * 4);
+    memset(left, 0, OUR_REPORT_WORDS * 4);
+    put_bits((uint8_t*) right, size, MOUSE_X.bitpos, MOUSE_X.size, 1);
+    put_bits((uint8_t*) left, size, MOUSE_X.bitpos, MOUSE_X.size, -1);
+}
+
+int main(int argc, char** argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 10000000;
+
+    host_capture = false;
+    FILE* out = host_init();
+
+    const struct {
+        const char* name;
+        uint8_t report_id;
+    } REPORTS[] = {
+        { "mouse", REPORT_ID_MOUSE },
+        { "keyboard", REPORT_ID_KEYBOARD },
+        { "consumer", REPORT_ID_CONSUMER },
+    };
+
+    volatile uint32_t sink = 0;
+
+    fprintf(out, "report    needs_to_be_sent  (bytewise)  is_edge  (bytewise) (ns)\n");
+    for (auto const& report : REPORTS) {
+        uint8_t id = report.report_id;
+        memcpy(reports[id], prev_reports[id], OUR_REPORT_WORDS * 4);
+        CHECK(!needs_to_be_sent(id) && !needs_to_be_sent_bytewise(id));
+        CHECK(!is_edge(id) && !is_edge_bytewise(id));
+        double send = time_per_call([&](int i) { sink = sink + needs_to_be_sent(id); }, rounds);
+        double send_bytewise = time_per_call([&](int i) { sink = sink + needs_to_be_sent_bytewise(id); }, rounds);
+        double edge = time_per_call([&](int i) { sink = sink + is_edge(id); }, rounds);
+        double edge_bytewise = time_per_call([&](int i) { sink = sink + is_edge_bytewise(id); }, rounds);
+        fprintf(out, "%-8s  %16.2f  %10.2f  %7.2f  %10.2f\n", report.name, send, send_bytewise, edge, edge_bytewise);
+    }
+
+    uint32_t moves[2][OUR_REPORT_WORDS];
+    make_moves(moves[0], moves[1]);
+
+    uint32_t sum[OUR_REPORT_WORDS] = {};
+    double aggregate = time_per_call([&](int i) { sink = sink + aggregate_relative((uint8_t*) sum, (const uint8_t*) moves[i % 2], REPORT_ID_MOUSE); }, rounds);
+
+    memcpy(reports[REPORT_ID_MOUSE], moves[0], OUR_REPORT_WORDS * 4);
+    CHECK(queue_report(REPORT_ID_MOUSE, true));
+    int8_t idx = newest_queued(motion_queue, REPORT_ID_MOUSE);
+    CHECK(idx != -1);
+    double merge = time_per_call([&](int i) { sink = sink + merge_into(motion_queue, idx, moves[(i + 1) % 2], REPORT_ID_MOUSE, EDGE_MASKS[REPORT_ID_MOUSE]); }, rounds);
+
+    fprintf(out, "\nmouse     aggregate_relative  merge_into (ns)\n");
+    fprintf(out, "          %18.2f  %10.2f\n", aggregate, merge);
+
+    return 0;
+}
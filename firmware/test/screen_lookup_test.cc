@@ -0,0 +1,99 @@
+#include <random>
+
+#include "globals.h"
+#include "host.h"
+#include "remapper.h"
+
+// find_screen() against going through all screens in index order and taking
+// the first one that has the point, which is what the cursor code did before
+// there were per-edge lists. Random layouts: screens next to each other,
+// with gaps, overlapping, inside each other and of zero width or height,
+// with every screen (and none) as the one the cursor is on. Then moving the
+// cursor around the same kind of layouts in every constraint mode: it can't
+// end up on a screen of zero width or height, nor outside the screen it's on.
+
+std::mt19937 rng(1);
+
+int8_t brute_force(int32_t x, int32_t y) {
+    for (uint8_t i = 0; i < screen_count; i++) {
+        const screen_def_t& screen = screens[i];
+        if (((int64_t) screen.x <= x) && (x < (int64_t) screen.x + screen.w) &&
+            ((int64_t) screen.y <= y) && (y < (int64_t) screen.y + screen.h)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void random_layout() {
+    screen_count = 1 + rng() % MAX_SCREENS;
+    // a coarse grid makes for shared edges and corners, a fine one for overlaps
+    uint32_t cell = (rng() % 2) ? 1000 : 7;
+    for (uint8_t i = 0; i < screen_count; i++) {
+        screen_def_t& screen = screens[i];
+        screen.x = 100000 + cell * (rng() % 8);
+        screen.y = 100000 + cell * (rng() % 8);
+        screen.w = cell * (rng() % 4);
+        screen.h = cell * (rng() % 4);
+        if (rng() % 4 == 0) {  // and not on the grid at all
+            screen.x += rng() % 2000;
+            screen.w += rng() % 2000;
+        }
+        screen.sensitivity = 1000;
+    }
+    screens_updated();
+}
+
+// mostly near screen edges, where things happen
+int32_t random_coordinate(bool horizontal) {
+    const screen_def_t& screen = screens[rng() % screen_count];
+    int64_t base = horizontal ? screen.x : screen.y;
+    int64_t size = horizontal ? screen.w : screen.h;
+    switch (rng() % 4) {
+        case 0:
+            return base + (int32_t) (rng() % 5) - 2;
+        case 1:
+            return base + size + (int32_t) (rng() % 5) - 2;
+        case 2:
+            return base + rng() % (size + 1);
+        default:
+            return 99000 + rng() % 12000;
+    }
+}
+
+void check_cursor() {
+    if (active_screen != -1) {
+        const screen_def_t& screen = screens[active_screen];
+        CHECK((screen.w > 0) && (screen.h > 0));
+        CHECK(brute_force(cursor_x, cursor_y) != -1);
+        CHECK(((int64_t) screen.x <= cursor_x) && (cursor_x < (int64_t) screen.x + screen.w));
+        CHECK(((int64_t) screen.y <= cursor_y) && (cursor_y < (int64_t) screen.y + screen.h));
+    }
+}
+
+int main() {
+    for (int layout = 0; layout < 5000; layout++) {
+        random_layout();
+        for (int8_t active = -1; active < screen_count; active++) {
+            for (int i = 0; i < 200; i++) {
+                int32_t x = random_coordinate(true);
+                int32_t y = random_coordinate(false);
+                active_screen = active;
+                CHECK(find_screen(x, y) == brute_force(x, y));
+            }
+        }
+    }
+
+    const ConstraintMode MODES[] = { ConstraintMode::NO_CONSTRAINT, ConstraintMode::BOUNDING_BOX, ConstraintMode::VISIBLE };
+    for (int layout = 0; layout < 5000; layout++) {
+        constraint_mode = MODES[layout % 3];
+        random_layout();
+        check_cursor();
+        for (int i = 0; i < 200; i++) {
+            move_cursor(random_coordinate(true), random_coordinate(false));
+            check_cursor();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "descriptor_parser.h"
+#include "devices.h"
+#include "globals.h"
+#include "host.h"
+#include "our_descriptor_layout.h"
+#include "remapper.h"
+
+// Every source mapped to a scroll target keeps its own partial lo-res scroll,
+// however many of them there are. Here A to Z (and then some) each scroll half
+// a click per tick. Pressing each of them for one tick, one after the other,
+// must not scroll at all, pressing one of them for two ticks scrolls a click.
+
+const uint16_t KEYBOARD = interface_of(2, 0);
+
+const int NSOURCES = 40;
+
+constexpr usage_def_t WHEEL = our_usage(0x00010038).def;
+
+int32_t scrolled() {
+    int32_t ret = 0;
+    for (int i = 0; i < 16; i++) {
+        send_report();
+    }
+    for (auto const& sent : host_sent) {
+        if ((sent.uart == -1) && (sent.report_id == WHEEL.report_id)) {
+            uint32_t value = get_bits(sent.data.data(), sent.data.size(), WHEEL.bitpos, WHEEL.size);
+            if (value & (1 << (WHEEL.size - 1))) {
+                value |= 0xFFFFFFFF << WHEEL.size;
+            }
+            ret += (int32_t) value;
+        }
+    }
+    host_sent.clear();
+    return ret;
+}
+
+void press(uint8_t key, int ticks) {
+    keyboard_report_t kbd = {};
+    kbd.keys[0] = key;
+    CHECK(handle_received_report((const uint8_t*) &kbd, sizeof(kbd), KEYBOARD));
+    for (int i = 0; i < ticks; i++) {
+        process_mapping(true);
+    }
+    kbd.keys[0] = 0;
+    CHECK(handle_received_report((const uint8_t*) &kbd, sizeof(kbd), KEYBOARD));
+    process_mapping(false);
+}
+
+int main() {
+    for (int i = 0; i < NSOURCES; i++) {
+        config_mappings.push_back({ .target_usage = 0x00010038, .source_usage = (uint32_t) (0x00070004 + i), .scaling = 500 });
+    }
+    host_init();
+    parse_descriptor(0x1234, 0x0002, KEYBOARD_DESCRIPTOR, sizeof(KEYBOARD_DESCRIPTOR), KEYBOARD);
+    their_descriptor_updated = false;
+    update_their_descriptor_derivates();
+
+    for (int i = 0; i < NSOURCES; i++) {
+        press(0x04 + i, 1);
+        CHECK(scrolled() == 0);
+    }
+    for (int i = 0; i < NSOURCES; i++) {
+        press(0x04 + i, 1);  // the other half
+        CHECK(scrolled() == 1);
+    }
+    press(0x04 + NSOURCES - 1, 2);
+    CHECK(scrolled() == 1);
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef _HOST_SDK_H_
+#define _HOST_SDK_H_
+
+// Just enough of the Pico SDK, TinyUSB and the board support package for the
+// firmware sources to compile and run on the host. Time only moves when a test
+// moves host_time_us.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <mutex>
+
+typedef unsigned int uint;
+
+extern uint64_t host_time_us;
+
+inline uint64_t time_us_64() {
+    return host_time_us;
+}
+
+inline uint32_t time_us_32() {
+    return host_time_us;
+}
+
+inline void sleep_ms(uint32_t ms) {
+    host_time_us += ms * 1000;
+}
+
+struct uart_inst_t {
+    uint8_t index;
+};
+
+extern uart_inst_t host_uarts[2];
+#define uart0 (&host_uarts[0])
+#define uart1 (&host_uarts[1])
+
+inline uint uart_init(uart_inst_t* uart, uint baudrate) {
+    return baudrate;
+}
+inline void uart_set_translate_crlf(uart_inst_t* uart, bool translate) {
+}
+inline void uart_set_hw_flow(uart_inst_t* uart, bool cts, bool rts) {
+}
+
+#define GPIO_FUNC_UART 2
+inline void gpio_set_function(uint gpio, uint fn) {
+}
+
+struct mutex_t {
+    std::mutex m;
+};
+
+// how many times this thread took a mutex and how many times it was ready to
+// wait for one, so tests can tell which paths lock and which ones could block
+inline thread_local uint32_t host_mutex_entries = 0;
+inline thread_local uint32_t host_mutex_waits = 0;
+
+inline void mutex_init(mutex_t* mtx) {
+}
+inline void mutex_enter_blocking(mutex_t* mtx) {
+    host_mutex_entries++;
+    host_mutex_waits++;
+    mtx->m.lock();
+}
+inline bool mutex_try_enter(mutex_t* mtx, uint32_t* owner_out) {
+    if (!mtx->m.try_lock()) {
+        return false;
+    }
+    host_mutex_entries++;
+    return true;
+}
+inline void mutex_exit(mutex_t* mtx) {
+    mtx->m.unlock();
+}
+
+inline void board_init() {
+}
+inline void board_led_write(bool state) {
+}
+
+#define CFG_TUD_HID_EP_BUFSIZE 64
+
+typedef enum {
+    HID_REPORT_TYPE_INVALID = 0,
+    HID_REPORT_TYPE_INPUT,
+    HID_REPORT_TYPE_OUTPUT,
+    HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+bool tud_hid_report(uint8_t report_id, const void* report, uint16_t len);
+bool tud_hid_ready();
+inline void tud_task() {
+}
+inline bool tusb_init() {
+    return true;
+}
+inline void tud_sof_isr_set(void (*handler)(uint32_t frame_count)) {
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "timer_wheel.h"
+
+// The timer wheel against a list of deadlines: random scheduling,
+// rescheduling and cancelling of timers from a few ticks to further out than
+// the wheel covers, some of it from the expiry callback, with the clock
+// starting out shortly before it wraps around.
+
+const uint16_t NTIMERS = 64;
+const uint16_t BUSY_TIMERS = 8;
+
+struct model_t {
+    bool pending = false;
+    uint32_t deadline;
+    uint32_t delay;
+};
+
+int fired_far_out = 0;  // timers that were parked beyond the top level
+
+std::mt19937 rng(1);
+
+uint32_t random_delay() {
+    switch (rng() % 8) {
+        case 0:
+            return 0;  // same as 1
+        case 1:
+        case 2:
+        case 3:
+            return 1 + rng() % 70;
+        case 4:
+        case 5:
+            return 1 + rng() % 5000;
+        case 6:
+            return 1 + rng() % (1 << 18);  // what the top level covers
+        default:
+            return (1 << 18) + rng() % 100000;  // more than that
+    }
+}
+
+void run(uint32_t start, int ticks) {
+    timer_wheel_t wheel;
+    wheel.now = start;
+    timer_wheel_reset(wheel, NTIMERS);
+    std::vector<model_t> model(NTIMERS);
+
+    auto schedule = [&](uint16_t id) {
+        uint32_t delay = random_delay();
+        timer_schedule(wheel, id, delay);
+        model[id] = { true, wheel.now + (delay ? delay : 1), delay };
+    };
+
+    for (int tick = 0; tick < ticks; tick++) {
+        // the first few timers get moved around all the time (in bursts),
+        // the others are left alone until they fire
+        int ops = (rng() % 16 == 0) ? rng() % 32 : rng() % 2;
+        for (int i = 0; i < ops; i++) {
+            uint16_t id = rng() % BUSY_TIMERS;
+            if (rng() % 4 == 0) {
+                timer_cancel(wheel, id);
+                model[id].pending = false;
+            } else {
+                schedule(id);
+            }
+        }
+        uint16_t id = BUSY_TIMERS + rng() % (NTIMERS - BUSY_TIMERS);
+        if (!model[id].pending && (rng() % 64 == 0)) {
+            schedule(id);
+        }
+
+        std::vector<bool> due(NTIMERS);
+        for (uint16_t id = 0; id < NTIMERS; id++) {
+            due[id] = model[id].pending && (model[id].deadline == wheel.now + 1);
+            if (due[id]) {
+                model[id].pending = false;
+                fired_far_out += model[id].delay > (1 << 18);
+            }
+        }
+        std::vector<bool> fired(NTIMERS);
+        timer_advance(wheel, [&](uint16_t id) {
+            CHECK(!fired[id]);
+            fired[id] = true;
+            if (rng() % 4 == 0) {
+                schedule(id);
+            }
+        });
+        for (uint16_t id = 0; id < NTIMERS; id++) {
+            CHECK(fired[id] == due[id]);
+            CHECK(timer_pending(wheel, id) == model[id].pending);
+            if (model[id].pending) {
+                CHECK(timer_remaining(wheel, id) == model[id].deadline - wheel.now);
+            }
+        }
+    }
+}
+
+int main() {
+    run(0, 1000000);
+    run(UINT32_MAX - 300000, 1000000);  // wraps around
+    run(UINT32_MAX - 5, 100000);
+    CHECK(fired_far_out > 100);
+    return 0;
+}